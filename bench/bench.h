@@ -0,0 +1,14 @@
+// Helpers shared by the benchmarks
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <time.h>
+
+// Monotonic wall clock time in seconds
+static inline double now_secs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#endif // BENCH_H_
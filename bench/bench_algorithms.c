@@ -0,0 +1,70 @@
+// Generation speed and peak memory of every maze algorithm
+//
+// Each run happens in a child process so the peak resident set size reported
+// by wait4() belongs to that run alone.
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define MAZE_H_IMPLEMENTATION
+#include "../maze.h"
+#include "bench.h"
+
+static void bench_run(MazeAlgorithm algo, size_t size) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        exit(71);
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(71);
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        double start = now_secs();
+        Env env = env_init(size, size, 1234);
+        gen_maze(&env, algo);
+        env_deinit(&env);
+        double secs = now_secs() - start;
+        maze_deinit(&env.maze);
+        if (write(fds[1], &secs, sizeof(secs)) != sizeof(secs)) _exit(1);
+        _exit(0);
+    }
+
+    close(fds[1]);
+    double secs = 0;
+    bool ok = read(fds[0], &secs, sizeof(secs)) == sizeof(secs);
+    close(fds[0]);
+    int status = 0;
+    struct rusage usage = {0};
+    wait4(pid, &status, 0, &usage);
+    if (!ok || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("%-21s %6zu  FAILED\n", maze_algorithm_name(algo), size);
+        return;
+    }
+    double cells = (double)size * size;
+    // ru_maxrss is in kilobytes on Linux
+    printf("%-21s %6zu %10.3f ms %10.2f Mcells/s %10.2f MB peak\n",
+           maze_algorithm_name(algo), size, secs * 1e3, cells / secs / 1e6, usage.ru_maxrss / 1024.0);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    size_t sizes[] = {64, 256, 1024, 2048, 4096, 8192, 16384};
+    size_t size_count = sizeof(sizes) / sizeof(sizes[0]);
+    // An optional argument sets the largest size of the sweep, which stops
+    // at 2048 unless asked for more
+    size_t max_size = argc > 1 ? strtoull(argv[1], NULL, 10) : 2048;
+
+    printf("%-21s %6s %13s %18s %16s\n", "algorithm", "size", "time", "throughput", "memory");
+    for (size_t i = 0; i < ALGO_COUNT; i++) {
+        for (size_t j = 0; j < size_count && sizes[j] <= max_size; j++) {
+            bench_run((MazeAlgorithm)i, sizes[j]);
+        }
+    }
+    return 0;
+}
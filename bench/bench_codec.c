@@ -0,0 +1,66 @@
+// Size and speed of the spanning-tree coding in maze_codec.h
+//
+// Usage: bench_codec.out [size] [tile-size] [repeats]
+// Defaults to 2048x2048 mazes, MAZE_CODEC_TILE_SIZE tiles and the best of 3
+// runs. Decode MB/s counts the two-bit grid that comes out, so it compares
+// directly with reading a raw .maze file; the region is one tile-sized
+// window in the middle of the maze.
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAZE_H_IMPLEMENTATION
+#include "../maze.h"
+#define MAZE_CODEC_H_IMPLEMENTATION
+#include "../maze_codec.h"
+#include "bench.h"
+
+int main(int argc, char** argv) {
+    size_t size = argc > 1 ? strtoull(argv[1], NULL, 10) : 2048;
+    size_t tile_size = argc > 2 ? strtoull(argv[2], NULL, 10) : MAZE_CODEC_TILE_SIZE;
+    size_t repeats = argc > 3 ? strtoull(argv[3], NULL, 10) : 3;
+    if (size == 0 || tile_size == 0 || tile_size > 0xFFFF || repeats == 0) {
+        fprintf(stderr, "ERROR: Nothing to run\n");
+        return 64;
+    }
+    size_t window = tile_size < size ? tile_size : size;
+    size_t grid_bytes = (size * size + CELLS_PER_BYTE - 1) / CELLS_PER_BYTE;
+
+    printf("%-21s %10s %12s %12s %12s %12s\n", "algorithm", "bits/cell", "enc Mcell/s", "dec Mcell/s",
+           "dec MB/s", "region ms");
+    for (size_t a = 0; a < ALGO_COUNT; a++) {
+        Env env = env_init(size, size, 1234);
+        gen_maze(&env, (MazeAlgorithm)a);
+        env_deinit(&env);
+
+        double encode = 1e30, decode = 1e30, region = 1e30;
+        EncodedMaze encoded = {0};
+        for (size_t i = 0; i < repeats; i++) {
+            encoded_maze_deinit(&encoded);
+            double start = now_secs();
+            encoded = maze_encode(&env.maze, tile_size);
+            double encoded_at = now_secs();
+            Maze decoded = maze_decode(encoded.bytes, encoded.length);
+            double decoded_at = now_secs();
+            Maze part = maze_decode_region(encoded.bytes, encoded.length, (size - window) / 2, (size - window) / 2,
+                                           window, window);
+            double region_at = now_secs();
+            if (memcmp(decoded.cells, env.maze.cells, grid_bytes) != 0) {
+                fprintf(stderr, "ERROR: %s did not decode to the same maze\n", maze_algorithm_name((MazeAlgorithm)a));
+                return 70;
+            }
+            maze_deinit(&part);
+            maze_deinit(&decoded);
+            if (encoded_at - start < encode) encode = encoded_at - start;
+            if (decoded_at - encoded_at < decode) decode = decoded_at - encoded_at;
+            if (region_at - decoded_at < region) region = region_at - decoded_at;
+        }
+        double cells = (double)size * size;
+        printf("%-21s %10.3f %12.1f %12.1f %12.1f %12.3f\n", maze_algorithm_name((MazeAlgorithm)a),
+               encoded.length * 8.0 / cells, cells / encode / 1e6, cells / decode / 1e6,
+               grid_bytes / decode / 1e6, region * 1e3);
+        fflush(stdout);
+        encoded_maze_deinit(&encoded);
+        maze_deinit(&env.maze);
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+// Push/pop throughput of the stack.h/vec.h containers
+//
+// `naive_*` is the old realloc-on-every-operation scheme, kept here only as a
+// baseline so the gain from geometric growth stays measurable.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STACK_TYPE uint32_t
+#define STACK_NAME IndexStack
+#define STACK_PREFIX index_stack
+#define STACK_H_IMPLEMENTATION
+#include "../stack.h"
+
+#define STACK_TYPE size_t
+#define STACK_H_IMPLEMENTATION
+#include "../stack.h"
+
+#define VEC_TYPE uint32_t
+#define VEC_H_IMPLEMENTATION
+#include "../vec.h"
+#include "bench.h"
+
+typedef struct {
+    uint32_t* items;
+    size_t count;
+} NaiveStack;
+
+static void naive_push(NaiveStack* stack, uint32_t val) {
+    stack->count++;
+    stack->items = (uint32_t*)realloc(stack->items, sizeof(uint32_t) * stack->count);
+    is_stack_mem_valid(stack->items);
+    stack->items[stack->count - 1] = val;
+}
+
+static uint32_t naive_pop(NaiveStack* stack) {
+    stack->count--;
+    uint32_t removed_item = stack->items[stack->count];
+    stack->items = (uint32_t*)realloc(stack->items, sizeof(uint32_t) * stack->count);
+    return removed_item;
+}
+
+// Keeps the optimizer from throwing the loops away
+static volatile uint64_t sink;
+
+static void report(const char* name, size_t ops, double secs) {
+    printf("%-28s %12zu ops %9.3f ms %10.2f Mops/s\n", name, ops, secs * 1e3, ops / secs / 1e6);
+}
+
+// The access pattern of the maze DFS: a growing stack where every step pops
+// the top and pushes it back together with a new item
+static void bench_naive(size_t n) {
+    NaiveStack stack = {0};
+    uint64_t sum = 0;
+    double start = now_secs();
+    naive_push(&stack, 0);
+    for (uint32_t i = 1; i < n; i++) {
+        uint32_t top = naive_pop(&stack);
+        naive_push(&stack, top);
+        naive_push(&stack, i);
+    }
+    while (stack.count > 0) sum += naive_pop(&stack);
+    double secs = now_secs() - start;
+    free(stack.items);
+    sink = sum;
+    report("naive realloc (u32)", 3 * n, secs);
+}
+
+static void bench_index_stack(size_t n, bool reuse) {
+    IndexStack stack = index_stack_init();
+    uint64_t sum = 0;
+    // Reserving up front shows the cost with no growth at all, i.e. a reused buffer
+    if (reuse) {
+        index_stack_reserve(&stack, n);
+    }
+    double start = now_secs();
+    index_stack_push(&stack, 0);
+    for (uint32_t i = 1; i < n; i++) {
+        uint32_t top = index_stack_pop(&stack);
+        index_stack_push(&stack, top);
+        index_stack_push(&stack, i);
+    }
+    while (stack.count > 0) sum += index_stack_pop(&stack);
+    double secs = now_secs() - start;
+    index_stack_deinit(&stack);
+    sink = sum;
+    report(reuse ? "IndexStack reserved (u32)" : "IndexStack (u32)", 3 * n, secs);
+}
+
+static void bench_stack(size_t n) {
+    Stack stack = stack_init();
+    uint64_t sum = 0;
+    double start = now_secs();
+    stack_push(&stack, 0);
+    for (size_t i = 1; i < n; i++) {
+        size_t top = stack_pop(&stack);
+        stack_push(&stack, top);
+        stack_push(&stack, i);
+    }
+    while (stack.count > 0) sum += stack_pop(&stack);
+    double secs = now_secs() - start;
+    stack_deinit(&stack);
+    sink = sum;
+    report("Stack (size_t)", 3 * n, secs);
+}
+
+static void bench_vec(size_t n) {
+    Vec vec = vec_init();
+    uint64_t sum = 0;
+    double start = now_secs();
+    for (uint32_t i = 0; i < n; i++) vec_append(&vec, i);
+    while (vec.length > 0) sum += vec_remove(&vec, vec.length - 1);
+    double secs = now_secs() - start;
+    vec_deinit(&vec);
+    sink = sum;
+    report("Vec append/remove (u32)", 2 * n, secs);
+}
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+    printf("Container push/pop throughput, %zu pushes\n", n);
+    bench_naive(n);
+    bench_index_stack(n, false);
+    bench_index_stack(n, true);
+    bench_stack(n);
+    bench_vec(n);
+    return 0;
+}
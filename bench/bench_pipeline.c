@@ -0,0 +1,327 @@
+// Timing of every stage of the pipeline: generation, rasterization with the
+// fill_rect() based init_maze() and the scanline render_maze(), and PPM
+// encoding with save_as_ppm() and with a baseline that writes pixel by pixel,
+// PGM/PBM/PNG output drawn straight from the grid by stream_maze_to_file(),
+// and PPM written through the buffered writer or drawn in place into a
+// mapped file
+//
+// Usage: bench_pipeline.out [OPTIONS]
+//     --max-size <n>     Largest side of the 32, 64, ... sweep (default: 512;
+//                        make bench-large goes up to 16384)
+//     --repeats <n>      Runs per configuration (default: 5)
+//     --budget <secs>    Stop repeating a configuration after this much time,
+//                        once it has 3 runs (default: 2)
+//     --algorithms <a,b> Comma separated algorithms (default: all)
+//     --threads <n,m>    Comma separated thread counts (default: 1 and nproc)
+//     --max-image-mb <n> Skip drawing and encoding larger images (default: 1024)
+//                        They are only timed with the first thread count
+//     --ppm <path>       Where encoded images go, whatever their format
+//                        (default: /dev/null)
+//     --file <path>      Real file for the stages that need one (default:
+//                        bench_output.ppm, removed afterwards)
+//     --csv <path>       Also write the results as CSV
+//
+// Medians and 99th percentiles use the nearest rank, so with few runs the
+// p99 is the slowest run.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAZE_H_IMPLEMENTATION
+#include "../maze.h"
+#define RENDER_H_IMPLEMENTATION
+#include "../render.h"
+#include "bench.h"
+
+#define MIN_SIZE 32
+#define MIN_RUNS 3
+#define TILE_SIZE 1024
+#define MAX_THREAD_COUNTS 16
+
+typedef enum {
+    STAGE_GENERATE,
+    STAGE_FILL_RECT,
+    STAGE_SCANLINE,
+    STAGE_SCANLINE_THREADED,
+    STAGE_ENCODE,
+    STAGE_ENCODE_NAIVE,
+    STAGE_GRID_PGM,
+    STAGE_GRID_PBM,
+    STAGE_GRID_PNG,
+    STAGE_FILE_PPM,
+    STAGE_MMAP_PPM,
+    STAGE_COUNT,
+} Stage;
+
+static const char* stage_names[STAGE_COUNT] = { "generate", "fill-rect", "scanline", "scanline-mt", "encode",
+                                              "encode-naive", "grid-pgm", "grid-pbm", "grid-png",
+                                              "file-ppm", "mmap-ppm" };
+
+// The PGM/PBM/PNG stages, in the order of the stages above
+static const ImageFormat grid_formats[] = { FORMAT_PGM, FORMAT_PBM, FORMAT_PNG };
+
+typedef struct {
+    size_t max_size;
+    size_t repeats;
+    double budget;
+    bool algorithms[ALGO_COUNT];
+    size_t threads[MAX_THREAD_COUNTS];
+    size_t thread_count;
+    size_t max_image_bytes;
+    const char* ppm_path;
+    const char* file_path;
+    FILE* csv;
+} Options;
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile(const double* sorted, size_t count, double p) {
+    size_t rank = (size_t)(p * count + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    return sorted[rank - 1];
+}
+
+static void report(const Options* opts, MazeAlgorithm algo, size_t threads, size_t size, Stage stage,
+                   double* samples, size_t runs, double amount, const char* unit) {
+    qsort(samples, runs, sizeof(double), compare_doubles);
+    double median = percentile(samples, runs, 0.5);
+    double p99 = percentile(samples, runs, 0.99);
+    double rate = amount / median;
+    printf("%-21s %7zu %6zu %-12s %4zu %12.3f ms %12.3f ms %10.2f %s\n",
+           maze_algorithm_name(algo), threads, size, stage_names[stage], runs,
+           median * 1e3, p99 * 1e3, rate, unit);
+    fflush(stdout);
+    if (opts->csv != NULL) {
+        fprintf(opts->csv, "%s,%zu,%zu,%s,%zu,%.6f,%.6f,%.4f,%s\n",
+                maze_algorithm_name(algo), threads, size, stage_names[stage], runs,
+                median * 1e3, p99 * 1e3, rate, unit);
+        fflush(opts->csv);
+    }
+}
+
+// The PPM writer before rows were buffered: one fwrite() per pixel
+static void save_as_ppm_naive(const Image* img, const char* filename) {
+    FILE* fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "ERROR: Failed to open '%s' for writing\n", filename);
+        exit(72);
+    }
+    fprintf(fp, "P6\n%zu %zu 255\n", img->width, img->height);
+    for (size_t y = 0; y < img->height; y++) {
+        for (size_t x = 0; x < img->width; x++) {
+            uint32_t pixel = img_at(img, x, y);
+            uint8_t bytes[3] = { (pixel >> 16) & 0xFF, (pixel >> 8) & 0xFF, pixel & 0xFF };
+            fwrite(bytes, sizeof(bytes), 1, fp);
+        }
+    }
+    fclose(fp);
+}
+
+static void generate(Maze* maze, MazeAlgorithm algo, size_t size, size_t threads) {
+    if (threads > 1) {
+        *maze = maze_init(size, size);
+        gen_maze_tiled(maze, algo, threads, TILE_SIZE, 1234);
+    } else {
+        Env env = env_init(size, size, 1234);
+        gen_maze(&env, algo);
+        env_deinit(&env);
+        *maze = env.maze;
+    }
+}
+
+// Drawing and encoding do not depend on how the maze was generated, so they
+// are only timed when `draw` is set. The threaded rasterizer is timed with
+// every thread count.
+static void bench_config(const Options* opts, MazeAlgorithm algo, size_t size, size_t threads, bool draw) {
+    double* samples[STAGE_COUNT];
+    for (size_t p = 0; p < STAGE_COUNT; p++) {
+        samples[p] = (double*)alloc_or_die(opts->repeats, sizeof(double), "the samples");
+    }
+    size_t width = image_width(size);
+    size_t height = image_height(size);
+    bool fits = (double)width * height * sizeof(uint32_t) <= (double)opts->max_image_bytes;
+    draw = draw && fits;
+
+    size_t runs = 0;
+    double spent = 0;
+    while (runs < opts->repeats && (runs < MIN_RUNS || spent < opts->budget)) {
+        Maze maze = {0};
+        double start = now_secs();
+        generate(&maze, algo, size, threads);
+        double generated = now_secs();
+        samples[STAGE_GENERATE][runs] = generated - start;
+        if (fits) {
+            Image img = image_init(size, size);
+            // Fault the image in first so no rasterizer pays for it
+            memset(img.pixels, 0xFF, img.width * img.height * sizeof(uint32_t));
+            double threaded = now_secs();
+            render_maze_threaded(&img, &maze, threads);
+            samples[STAGE_SCANLINE_THREADED][runs] = now_secs() - threaded;
+            double mapping = now_secs();
+            render_maze_to_mapped_file(&maze, opts->file_path, FORMAT_PPM, threads);
+            samples[STAGE_MMAP_PPM][runs] = now_secs() - mapping;
+            if (draw) {
+                double scanning = now_secs();
+                render_maze(&img, &maze);
+                double filling = now_secs();
+                init_maze(&img, &maze);
+                double drawn = now_secs();
+                save_as_ppm(&img, opts->ppm_path);
+                double saved = now_secs();
+                save_as_ppm_naive(&img, opts->ppm_path);
+                samples[STAGE_ENCODE_NAIVE][runs] = now_secs() - saved;
+                samples[STAGE_SCANLINE][runs] = filling - scanning;
+                samples[STAGE_FILL_RECT][runs] = drawn - filling;
+                samples[STAGE_ENCODE][runs] = saved - drawn;
+                for (size_t f = 0; f < sizeof(grid_formats) / sizeof(grid_formats[0]); f++) {
+                    double streaming = now_secs();
+                    stream_maze_to_file(&maze, opts->ppm_path, grid_formats[f]);
+                    samples[STAGE_GRID_PGM + f][runs] = now_secs() - streaming;
+                }
+                double filing = now_secs();
+                stream_maze_to_file(&maze, opts->file_path, FORMAT_PPM);
+                samples[STAGE_FILE_PPM][runs] = now_secs() - filing;
+            }
+            image_deinit(&img);
+        }
+        maze_deinit(&maze);
+        spent += now_secs() - start;
+        runs++;
+    }
+
+    double cells = (double)size * size;
+    report(opts, algo, threads, size, STAGE_GENERATE, samples[STAGE_GENERATE], runs, cells / 1e6, "Mcells/s");
+    if (fits) {
+        report(opts, algo, threads, size, STAGE_SCANLINE_THREADED, samples[STAGE_SCANLINE_THREADED], runs,
+               (double)width * height * sizeof(uint32_t) / 1e6, "MB/s");
+        report(opts, algo, threads, size, STAGE_MMAP_PPM, samples[STAGE_MMAP_PPM], runs,
+               (double)width * height * 3 / 1e6, "MB/s");
+    }
+    if (draw) {
+        double pixels = (double)width * height;
+        report(opts, algo, threads, size, STAGE_FILL_RECT, samples[STAGE_FILL_RECT], runs,
+               pixels * sizeof(uint32_t) / 1e6, "MB/s");
+        report(opts, algo, threads, size, STAGE_SCANLINE, samples[STAGE_SCANLINE], runs,
+               pixels * sizeof(uint32_t) / 1e6, "MB/s");
+        report(opts, algo, threads, size, STAGE_ENCODE, samples[STAGE_ENCODE], runs,
+               pixels * 3 / 1e6, "MB/s");
+        report(opts, algo, threads, size, STAGE_ENCODE_NAIVE, samples[STAGE_ENCODE_NAIVE], runs,
+               pixels * 3 / 1e6, "MB/s");
+        double packed_row = (double)((width + 7) / 8);
+        report(opts, algo, threads, size, STAGE_GRID_PGM, samples[STAGE_GRID_PGM], runs,
+               pixels / 1e6, "MB/s");
+        report(opts, algo, threads, size, STAGE_GRID_PBM, samples[STAGE_GRID_PBM], runs,
+               packed_row * height / 1e6, "MB/s");
+        report(opts, algo, threads, size, STAGE_GRID_PNG, samples[STAGE_GRID_PNG], runs,
+               (packed_row + 1) * height / 1e6, "MB/s");
+        report(opts, algo, threads, size, STAGE_FILE_PPM, samples[STAGE_FILE_PPM], runs,
+               pixels * 3 / 1e6, "MB/s");
+    }
+    for (size_t p = 0; p < STAGE_COUNT; p++) free(samples[p]);
+}
+
+static size_t parse_list(const char* value, size_t* out, size_t max) {
+    size_t count = 0;
+    char* end = NULL;
+    while (count < max) {
+        size_t n = strtoull(value, &end, 10);
+        if (end == value || n == 0) break;
+        out[count++] = n;
+        if (*end != ',') break;
+        value = end + 1;
+    }
+    return count;
+}
+
+static void parse_algorithms(const char* value, bool* algorithms) {
+    char name[64];
+    while (*value != '\0') {
+        size_t len = strcspn(value, ",");
+        MazeAlgorithm algo;
+        snprintf(name, sizeof(name), "%.*s", (int)len, value);
+        if (!maze_algorithm_from_name(name, &algo)) {
+            fprintf(stderr, "ERROR: '%s' is not a known algorithm\n", name);
+            exit(64);
+        }
+        algorithms[algo] = true;
+        value += len;
+        if (*value == ',') value++;
+    }
+}
+
+int main(int argc, char** argv) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    Options opts = {
+        .max_size = 512,
+        .repeats = 5,
+        .budget = 2,
+        .threads = { 1, (size_t)(cpus > 1 ? cpus : 1) },
+        .thread_count = cpus > 1 ? 2 : 1,
+        .max_image_bytes = (size_t)1024 << 20,
+        .ppm_path = "/dev/null",
+        .file_path = "bench_output.ppm",
+    };
+    bool any_algorithm = false;
+    for (int i = 1; i < argc; i++) {
+        const char* flag = argv[i];
+        const char* value = i + 1 < argc ? argv[++i] : "";
+        if (strcmp(flag, "--max-size") == 0) {
+            opts.max_size = strtoull(value, NULL, 10);
+        } else if (strcmp(flag, "--repeats") == 0) {
+            opts.repeats = strtoull(value, NULL, 10);
+        } else if (strcmp(flag, "--budget") == 0) {
+            opts.budget = strtod(value, NULL);
+        } else if (strcmp(flag, "--algorithms") == 0) {
+            parse_algorithms(value, opts.algorithms);
+            any_algorithm = true;
+        } else if (strcmp(flag, "--threads") == 0) {
+            opts.thread_count = parse_list(value, opts.threads, MAX_THREAD_COUNTS);
+        } else if (strcmp(flag, "--max-image-mb") == 0) {
+            opts.max_image_bytes = (size_t)strtoull(value, NULL, 10) << 20;
+        } else if (strcmp(flag, "--ppm") == 0) {
+            opts.ppm_path = value;
+        } else if (strcmp(flag, "--file") == 0) {
+            opts.file_path = value;
+        } else if (strcmp(flag, "--csv") == 0) {
+            opts.csv = fopen(value, "w");
+            if (opts.csv == NULL) {
+                fprintf(stderr, "ERROR: Failed to open '%s' for writing\n", value);
+                return 72;
+            }
+        } else {
+            fprintf(stderr, "ERROR: Unknown option '%s'\n", flag);
+            return 64;
+        }
+    }
+    if (opts.repeats == 0 || opts.thread_count == 0) {
+        fprintf(stderr, "ERROR: Nothing to run\n");
+        return 64;
+    }
+    if (!any_algorithm) {
+        for (size_t i = 0; i < ALGO_COUNT; i++) opts.algorithms[i] = true;
+    }
+
+    if (opts.csv != NULL) {
+        fprintf(opts.csv, "algorithm,threads,size,stage,runs,median_ms,p99_ms,throughput,unit\n");
+    }
+    printf("%-21s %7s %6s %-12s %4s %15s %15s %10s\n",
+           "algorithm", "threads", "size", "stage", "runs", "median", "p99", "throughput");
+    for (size_t i = 0; i < ALGO_COUNT; i++) {
+        if (!opts.algorithms[i]) continue;
+        for (size_t t = 0; t < opts.thread_count; t++) {
+            for (size_t size = MIN_SIZE; size <= opts.max_size; size *= 2) {
+                bench_config(&opts, (MazeAlgorithm)i, size, opts.threads[t], t == 0);
+            }
+        }
+    }
+    if (opts.csv != NULL) fclose(opts.csv);
+    unlink(opts.file_path);
+    return 0;
+}
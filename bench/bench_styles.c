@@ -0,0 +1,102 @@
+// Row kernels for different cell and wall sizes: the kernel the style
+// selects next to the generic fallback, drawing RGB and indexed pixels
+//
+// Usage: bench_styles.out [size] [repeats]
+// Defaults to a 1024x1024 maze and the best of 5 runs. Every row of cells is
+// drawn into the same band, so the numbers are the kernels and not the
+// memory bandwidth of a whole image.
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAZE_H_IMPLEMENTATION
+#include "../maze.h"
+#define RENDER_H_IMPLEMENTATION
+#include "../render.h"
+#include "bench.h"
+
+typedef struct {
+    const char* name;
+    RenderStyle style;
+} NamedStyle;
+
+static const NamedStyle styles[] = {
+    { "10x10+1",  { 10, 10, 1, DEFAULT_SOLID, DEFAULT_OPEN } },
+    { "1x1+1",    { 1, 1, 1, DEFAULT_SOLID, DEFAULT_OPEN } },
+    { "4x4+1",    { 4, 4, 1, DEFAULT_SOLID, DEFAULT_OPEN } },
+    { "8x8+1",    { 8, 8, 1, DEFAULT_SOLID, DEFAULT_OPEN } },
+    { "16x16+1",  { 16, 16, 1, DEFAULT_SOLID, DEFAULT_OPEN } },
+    { "7x7+3",    { 7, 7, 3, DEFAULT_SOLID, DEFAULT_OPEN } },
+    { "10x10+2",  { 10, 10, 2, DEFAULT_SOLID, DEFAULT_OPEN } },
+};
+
+// Unpacked wall bytes of every row, so the loops below only time drawing
+static uint8_t* unpack_walls(const Maze* maze) {
+    uint8_t* walls = (uint8_t*)alloc_or_die(maze->rows * maze->cols, sizeof(uint8_t), "the walls");
+    for (size_t i = 0; i < maze->rows * maze->cols; i++) walls[i] = maze_cell(maze, i);
+    return walls;
+}
+
+static double time_rgb(const Maze* maze, const uint8_t* walls, uint32_t* band, size_t width, size_t repeats,
+                       void (*kernel)(uint32_t*, size_t, const uint8_t*, size_t)) {
+    double best = 1e30;
+    for (size_t i = 0; i < repeats; i++) {
+        double start = now_secs();
+        for (size_t r = 0; r < maze->rows; r++) kernel(band, width, walls + r * maze->cols, maze->cols);
+        double secs = now_secs() - start;
+        if (secs < best) best = secs;
+    }
+    return best;
+}
+
+static double time_indexed(const Maze* maze, const uint8_t* walls, uint8_t* band, size_t width, size_t repeats,
+                           void (*kernel)(uint8_t*, size_t, const uint8_t*, size_t)) {
+    double best = 1e30;
+    for (size_t i = 0; i < repeats; i++) {
+        double start = now_secs();
+        for (size_t r = 0; r < maze->rows; r++) kernel(band, width, walls + r * maze->cols, maze->cols);
+        double secs = now_secs() - start;
+        if (secs < best) best = secs;
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    size_t size = argc > 1 ? strtoull(argv[1], NULL, 10) : 1024;
+    size_t repeats = argc > 2 ? strtoull(argv[2], NULL, 10) : 5;
+    if (size == 0 || repeats == 0) {
+        fprintf(stderr, "ERROR: Nothing to run\n");
+        return 64;
+    }
+    Env env = env_init(size, size, 1234);
+    gen_maze(&env, ALGO_BACKTRACKER);
+    env_deinit(&env);
+    uint8_t* walls = unpack_walls(&env.maze);
+
+    printf("%-10s %-8s %14s %14s %14s %14s\n", "style", "kernel", "rgb MB/s", "rgb generic", "index MB/s",
+           "index generic");
+    for (size_t s = 0; s < sizeof(styles) / sizeof(styles[0]); s++) {
+        if (!render_set_style(styles[s].style)) {
+            fprintf(stderr, "ERROR: Style '%s' is not valid\n", styles[s].name);
+            return 64;
+        }
+        size_t width = image_width(size);
+        size_t pixels = width * CELL_ROW_HEIGHT * size;
+        uint32_t* band = (uint32_t*)alloc_or_die(width * CELL_ROW_HEIGHT, sizeof(uint32_t), "the pixel band");
+        uint8_t* indices = (uint8_t*)alloc_or_die(width * CELL_ROW_HEIGHT, sizeof(uint8_t), "the pixel band");
+
+        double rgb = time_rgb(&env.maze, walls, band, width, repeats, render_cell_row);
+        double rgb_generic = time_rgb(&env.maze, walls, band, width, repeats, render_cell_row_generic);
+        double indexed = time_indexed(&env.maze, walls, indices, width, repeats, render_cell_row_indexed);
+        double indexed_generic = time_indexed(&env.maze, walls, indices, width, repeats,
+                                              render_cell_row_indexed_generic);
+        printf("%-10s %-8s %14.1f %14.1f %14.1f %14.1f\n", styles[s].name, render_kernel_name(),
+               pixels * sizeof(uint32_t) / rgb / 1e6, pixels * sizeof(uint32_t) / rgb_generic / 1e6,
+               pixels / indexed / 1e6, pixels / indexed_generic / 1e6);
+        fflush(stdout);
+        free(indices);
+        free(band);
+    }
+    free(walls);
+    maze_deinit(&env.maze);
+    return 0;
+}
@@ -0,0 +1,50 @@
+// Thread scaling of tiled maze generation
+//
+// Usage: bench_threads.out [size] [max-threads] [algorithm]
+// Defaults to a 2048x2048 maze and every power of two up to the number of
+// online CPUs; make bench-large uses a 16384x16384 maze.
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define MAZE_H_IMPLEMENTATION
+#include "../maze.h"
+#include "bench.h"
+
+#define TILE_SIZE 1024
+
+static double bench_run(MazeAlgorithm algo, size_t size, size_t threads) {
+    Maze maze = maze_init(size, size);
+    double start = now_secs();
+    gen_maze_tiled(&maze, algo, threads, TILE_SIZE, 1234);
+    double secs = now_secs() - start;
+    maze_deinit(&maze);
+    return secs;
+}
+
+int main(int argc, char** argv) {
+    size_t size = argc > 1 ? strtoull(argv[1], NULL, 10) : 2048;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t max_threads = argc > 2 ? strtoull(argv[2], NULL, 10) : (size_t)(cpus > 0 ? cpus : 1);
+    MazeAlgorithm algo = ALGO_BACKTRACKER;
+    if (argc > 3 && !maze_algorithm_from_name(argv[3], &algo)) {
+        fprintf(stderr, "ERROR: '%s' is not a known algorithm\n", argv[3]);
+        return 64;
+    }
+
+    printf("Tiled %s generation of a %zux%zu maze, %dx%d tiles\n",
+           maze_algorithm_name(algo), size, size, TILE_SIZE, TILE_SIZE);
+    printf("%8s %12s %16s %8s\n", "threads", "time", "throughput", "speedup");
+    double baseline = 0;
+    for (size_t threads = 1; threads <= max_threads;) {
+        double secs = bench_run(algo, size, threads);
+        if (threads == 1) baseline = secs;
+        printf("%8zu %9.3f ms %9.2f Mcells/s %7.2fx\n",
+               threads, secs * 1e3, (double)size * size / secs / 1e6, baseline / secs);
+        fflush(stdout);
+        if (threads == max_threads) break;
+        // Always finish on the full thread count, even if it is not a power of two
+        threads = threads * 2 > max_threads ? max_threads : threads * 2;
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+// Cost of drawing pyramid tiles straight from the cells: full-size tiles
+// with render_window_indexed() and every smaller level with
+// render_window_shaded(), which draws and adds up blocks of up to
+// SHADE_DRAWN_MAX_BLOCK pixels and counts wall bits for larger ones
+//
+// render_thumbnail() is timed for a few sizes after that.
+//
+// Usage: bench_tiles.out [size] [tiles]
+// Defaults to a 2048x2048 maze and 64 tiles of PYRAMID_TILE_SIZE pixels per
+// level, taken row by row from the top left corner. No files are written.
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAZE_H_IMPLEMENTATION
+#include "../maze.h"
+#define RENDER_H_IMPLEMENTATION
+#include "../render.h"
+#include "../pyramid.h"
+#include "bench.h"
+
+int main(int argc, char** argv) {
+    size_t size = argc > 1 ? strtoull(argv[1], NULL, 10) : 2048;
+    size_t tiles = argc > 2 ? strtoull(argv[2], NULL, 10) : 64;
+    if (size == 0 || tiles == 0) {
+        fprintf(stderr, "ERROR: Nothing to run\n");
+        return 64;
+    }
+    Env env = env_init(size, size, 1234);
+    gen_maze(&env, ALGO_BACKTRACKER);
+    env_deinit(&env);
+    size_t width = image_width(size);
+    size_t height = image_height(size);
+    size_t tile_size = PYRAMID_TILE_SIZE;
+    uint8_t* pixels = (uint8_t*)alloc_or_die(tile_size * tile_size, sizeof(uint8_t), "the tile");
+
+    printf("%8s %12s %8s %12s %12s\n", "scale", "level size", "tiles", "ms/tile", "ns/pixel");
+    for (size_t scale = 1; scale / 2 < width || scale / 2 < height; scale *= 2) {
+        size_t level_w = (width + scale - 1) / scale;
+        size_t level_h = (height + scale - 1) / scale;
+        size_t across = (level_w + tile_size - 1) / tile_size;
+        size_t total = across * ((level_h + tile_size - 1) / tile_size);
+        size_t count = total < tiles ? total : tiles;
+        size_t drawn = 0;
+        double start = now_secs();
+        for (size_t t = 0; t < count; t++) {
+            size_t x = t % across * tile_size;
+            size_t y = t / across * tile_size;
+            size_t w = level_w - x < tile_size ? level_w - x : tile_size;
+            size_t h = level_h - y < tile_size ? level_h - y : tile_size;
+            if (scale == 1) {
+                render_window_indexed(&env.maze, pixels, x, y, w, h);
+            } else {
+                render_window_shaded(&env.maze, pixels, x, y, w, h, scale);
+            }
+            drawn += w * h;
+        }
+        double secs = now_secs() - start;
+        printf("%8zu %5zux%-6zu %8zu %12.3f %12.1f\n", scale, level_w, level_h, count, secs / count * 1e3,
+               secs / drawn * 1e9);
+        fflush(stdout);
+    }
+
+    // The image is not a power of two wide, so thumbnail blocks are uneven
+    printf("\n%8s %12s %12s %12s\n", "thumb", "size", "ms", "ns/cell");
+    for (size_t thumb = 32; thumb <= 1024; thumb *= 2) {
+        size_t w = 0, h = 0;
+        thumbnail_size(&env.maze, thumb, &w, &h);
+        uint8_t* shades = (uint8_t*)alloc_or_die(w * h, sizeof(uint8_t), "the thumbnail");
+        double start = now_secs();
+        render_thumbnail(&env.maze, shades, w, h);
+        double secs = now_secs() - start;
+        printf("%8zu %5zux%-6zu %12.3f %12.3f\n", thumb, w, h, secs * 1e3, secs / ((double)size * size) * 1e9);
+        fflush(stdout);
+        free(shades);
+    }
+    free(pixels);
+    maze_deinit(&env.maze);
+    return 0;
+}
@@ -0,0 +1,60 @@
+// CRC-32 as used by zlib, PNG and the .maze files
+//
+// Define CRC32_H_IMPLEMENTATION in exactly one file before including this
+// header to get the function definitions.
+#ifndef CRC32_H_
+#define CRC32_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Continues `crc`, the finished CRC of everything before `bytes`; start
+// with 0. Gives the same values as zlib's crc32().
+uint32_t crc32_update(uint32_t crc, const void* bytes, size_t count);
+
+#endif // CRC32_H_
+
+#if defined(CRC32_H_IMPLEMENTATION) && !defined(CRC32_H_IMPLEMENTED)
+#define CRC32_H_IMPLEMENTED
+#include <pthread.h>
+#include <string.h>
+
+// crc32_tables[k][n] is the CRC of byte n followed by k zero bytes, so eight
+// bytes can be folded in with eight independent lookups
+static uint32_t crc32_tables[8][256];
+static pthread_once_t crc32_tables_once = PTHREAD_ONCE_INIT;
+
+static void crc32_init_tables(void) {
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crc32_tables[0][n] = c;
+    }
+    for (uint32_t n = 0; n < 256; n++) {
+        for (int k = 1; k < 8; k++) {
+            uint32_t c = crc32_tables[k - 1][n];
+            crc32_tables[k][n] = crc32_tables[0][c & 0xFF] ^ (c >> 8);
+        }
+    }
+}
+
+uint32_t crc32_update(uint32_t crc, const void* bytes, size_t count) {
+    pthread_once(&crc32_tables_once, crc32_init_tables);
+    const uint8_t* p = (const uint8_t*)bytes;
+    crc = ~crc;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for (; count >= 8; count -= 8, p += 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = crc32_tables[7][lo & 0xFF] ^ crc32_tables[6][(lo >> 8) & 0xFF] ^
+              crc32_tables[5][(lo >> 16) & 0xFF] ^ crc32_tables[4][lo >> 24] ^
+              crc32_tables[3][hi & 0xFF] ^ crc32_tables[2][(hi >> 8) & 0xFF] ^
+              crc32_tables[1][(hi >> 16) & 0xFF] ^ crc32_tables[0][hi >> 24];
+    }
+#endif
+    for (; count > 0; count--, p++) crc = crc32_tables[0][(crc ^ *p) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+#endif // CRC32_H_IMPLEMENTATION
@@ -1,286 +1,745 @@
+#include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <time.h>
+#include <errno.h>
+#include <sys/stat.h>
 
-#define to_ind(r, c) (r) * MAZE_ROWS + (c)
-#define in_bound(num, low, high) ((num) >= (low) && (num) < (high))
+// Default maze dimensions when none are given on the command line
+#define DEFAULT_MAZE_ROWS 30
+#define DEFAULT_MAZE_COLS 30
+// Image file single mazes are written to, plus the extension of the format
+#define DEFAULT_OUTPUT_NAME "out"
+// Directory batch mode writes its numbered mazes to
+#define DEFAULT_OUTPUT_DIR "mazes"
+// Most thumbnail sizes --thumbnails takes
+#define MAX_THUMBNAILS 8
 
-typedef struct {
-    size_t id;
-    bool visited;
-} Cell;
+#define MAZE_H_IMPLEMENTATION
+#include "maze.h"
 
-Cell cell_init(size_t id) {
-    return (Cell) {
-        .id = id,
-        .visited = false,
-    };
-}
+#define RENDER_H_IMPLEMENTATION
+#include "render.h"
 
-typedef enum {
-    CENTER,
-    NORTH,
-    SOUTH,
-    WEST,
-    EAST,
-} NeighborDir;
+#define MAZE_FILE_H_IMPLEMENTATION
+#include "maze_file.h"
 
-typedef enum {
-    VERTICAL,
-    HORIZONTAL
-} WallType;
+#define PYRAMID_H_IMPLEMENTATION
+#include "pyramid.h"
 
-typedef struct {
-    size_t start;
-    size_t target;
-    WallType type;
-} Wall;
-
-Wall wall_init(size_t start, size_t target, WallType type) {
-    return (Wall) {
-        .start = start,
-        .target = target,
-        .type = type
-    };
-}
+#define VEC_TYPE uint64_t
+#define VEC_H_IMPLEMENTATION
+#include "vec.h"
 
-#ifndef MAZE_SIZE
-#define MAZE_SIZE 30
+// Generates with Eller's algorithm and renders every row of cells as soon as
+// it is carved, so memory use depends on the width alone
+void stream_maze(size_t rows, size_t cols, uint64_t seed, const char* filename, ImageFormat format) {
+    size_t width = image_width(cols);
+    ImageWriter writer = image_writer_open(filename, format, width, image_height(rows));
+    uint8_t* band = (uint8_t*)alloc_or_die(width * CELL_ROW_HEIGHT, sizeof(uint8_t), "the pixel band");
+    uint8_t* walls = (uint8_t*)alloc_or_die(cols, sizeof(uint8_t), "the maze row");
+    // Seeded the way gen_maze_eller() seeds it, so this is the same maze
+    // the other paths generate for `seed`
+    Rng rng = rng_init(seed);
+    EllerRow row = eller_init(cols, rng_next(&rng));
+
+    // Top border
+    memset(band, INDEX_SOLID, width * render_style.border);
+    image_writer_write_indexed(&writer, band, render_style.border);
+    for (size_t r = 0; r < rows; r++) {
+        INSTR_PHASE_BEGIN(generate);
+        eller_next_row(&row, walls, r + 1 == rows);
+        INSTR_PHASE_END(PHASE_GENERATE, generate);
+#ifdef MAZE_INSTRUMENT
+        // The rows never go through maze_open()
+        for (size_t c = 0; c < cols; c++) INSTR_ADD(walls_removed, __builtin_popcount(walls[c]));
 #endif
+        INSTR_PHASE_BEGIN(rasterize);
+        render_cell_row_indexed(band, width, walls, cols);
+        INSTR_PHASE_END(PHASE_RASTERIZE, rasterize);
+        INSTR_PHASE_BEGIN(encode);
+        image_writer_write_indexed(&writer, band, CELL_ROW_HEIGHT);
+        INSTR_PHASE_END(PHASE_ENCODE, encode);
+    }
+    INSTR_ADD(mazes, 1);
 
-#define MAZE_ROWS MAZE_SIZE
-#define MAZE_COLS MAZE_SIZE
-
-#define STACK_TYPE Cell*
-#define STACK_H_IMPLEMENTATION
-#include "stack.h"
-
-#define VEC_TYPE Wall
-#define VEC_H_IMPLEMENTATION
-#include "vec.h"
+    eller_deinit(&row);
+    free(walls);
+    free(band);
+    image_writer_close(&writer);
+}
 
 typedef struct {
-    Cell grid[MAZE_ROWS*MAZE_COLS];
-    Stack stack;
-    // Source: https://math.stackexchange.com/questions/4350136/how-many-adjacent-edges-in-an-n-times-n-grid-of-squares
-    // For any nxn grid, the number of adjacent edges is defined by the formula: (2*n)*(n-1)
-    Vec removed_walls;
-} Env;
-
-Env env_init() {
-    Env env = {0};
-    // Reset grid
-    for (size_t r = 0; r < MAZE_ROWS; r++) {
-        for (size_t c = 0; c < MAZE_COLS; c++) {
-            env.grid[to_ind(r, c)] = cell_init(to_ind(r, c));
+    size_t rows;
+    size_t cols;
+    MazeAlgorithm algo;
+    ImageFormat format;
+    const char* output_dir;
+    const size_t* thumbnails;
+    size_t thumbnail_count;
+    // One seed per maze; the maze index names the output file
+    const uint64_t* seeds;
+    size_t count;
+    // Index of the next maze nobody has claimed yet
+    size_t next;
+} BatchJob;
+
+// Every worker keeps one Env and one Image for its whole share of the batch
+static void* batch_worker(void* arg) {
+    BatchJob* job = (BatchJob*)arg;
+    Env env = env_init(job->rows, job->cols, 0);
+    Image img = image_init(job->rows, job->cols);
+    // Room for the longest name in the directory, a thumbnail's
+    size_t path_size = strlen(job->output_dir) + 96;
+    char* path = (char*)alloc_or_die(path_size, sizeof(char), "the maze path");
+    for (;;) {
+        size_t i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (i >= job->count) break;
+        env_reset(&env, job->seeds[i]);
+        INSTR_PHASE_BEGIN(generate);
+        gen_maze(&env, job->algo);
+        INSTR_PHASE_END(PHASE_GENERATE, generate);
+        INSTR_ADD(mazes, 1);
+        INSTR_PHASE_BEGIN(rasterize);
+        render_maze(&img, &env.maze);
+        INSTR_PHASE_END(PHASE_RASTERIZE, rasterize);
+        snprintf(path, path_size, "%s/maze_%06zu.%s", job->output_dir, i, image_format_name(job->format));
+        INSTR_PHASE_BEGIN(encode);
+        save_image(&img, path, job->format);
+        INSTR_PHASE_END(PHASE_ENCODE, encode);
+        for (size_t t = 0; t < job->thumbnail_count; t++) {
+            snprintf(path, path_size, "%s/maze_%06zu_thumb%zu.%s", job->output_dir, i, job->thumbnails[t],
+                     image_format_name(job->format));
+            INSTR_PHASE_BEGIN(rasterize);
+            render_thumbnail_to_file(&env.maze, path, job->format, job->thumbnails[t]);
+            INSTR_PHASE_END(PHASE_RASTERIZE, rasterize);
         }
     }
-    env.removed_walls = vec_init();
-    env.stack = stack_init();
-    return env;
-}
-
-void env_deinit(Env* env) {
-    stack_deinit(&env->stack);
-    vec_deinit(&env->removed_walls);
+    free(path);
+    image_deinit(&img);
+    env_deinit(&env);
+    maze_deinit(&env.maze);
+    return NULL;
 }
 
-void shuffle(NeighborDir sides[4]) {
-    size_t n = 4;
-    for (size_t i = n - 1; i >= 1; i--) {
-        size_t j = rand() % i;
-        NeighborDir temp = sides[i];
-        sides[i] = sides[j];
-        sides[j] = temp;
+void run_batch(BatchJob* job, size_t threads) {
+    if (mkdir(job->output_dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "ERROR: Failed to create directory '%s'\n", job->output_dir);
+        exit(73); // UNIX sysexit.h error code 73
     }
+    if (threads > job->count) threads = job->count;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    run_workers(batch_worker, job, threads);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    printf("Generated %zu mazes into '%s' in %.3f s (%.1f mazes/s)\n",
+           job->count, job->output_dir, secs, secs > 0 ? job->count / secs : 0.0);
 }
 
-NeighborDir unvisited_neighbors(Cell* grid, int row, int col) {
-    (void) grid;
-    (void) row;
-    (void) col;
-    NeighborDir sides[4] = {NORTH, SOUTH, EAST, WEST};
-    shuffle(sides);
-    int new_row = row;
-    int new_col = col;
-    for (size_t i = 0; i < 4; i++) {
-        switch (sides[i]) {
-            case NORTH: new_row = row - 1; break;
-            case SOUTH: new_row = row + 1; break;
-            case  WEST: new_col = col - 1; break;
-            case  EAST: new_col = col + 1; break;
-            default: break; // CENTER
+// Reads one seed per line, skipping blank lines and `#` comments
+static uint64_t* read_seeds(FILE* fp, size_t* count) {
+    Vec seeds = vec_init();
+    char line[256];
+    size_t line_number = 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        line_number++;
+        // A longer line would come back in pieces, each read as a seed
+        if (strchr(line, '\n') == NULL && !feof(fp)) {
+            fprintf(stderr, "ERROR: Line %zu of the job list is too long\n", line_number);
+            exit(65); // UNIX sysexit.h error code 65
         }
-        if (in_bound(new_row, 0, MAZE_ROWS) &&
-            in_bound(new_col, 0, MAZE_COLS) &&
-            !grid[to_ind(new_row, new_col)].visited) {
-            return sides[i];
+        char* start = line;
+        while (*start == ' ' || *start == '\t') start++;
+        if (*start == '\n' || *start == '\0' || *start == '#') continue;
+        char* end = NULL;
+        errno = 0;
+        unsigned long long seed = strtoull(start, &end, 10);
+        bool parsed = end != start && errno != ERANGE;
+        while (*end == ' ' || *end == '\t' || *end == '\r' || *end == '\n') end++;
+        if (!parsed || *start == '-' || *end != '\0') {
+            fprintf(stderr, "ERROR: Line %zu of the job list is not a valid seed\n", line_number);
+            exit(65); // UNIX sysexit.h error code 65
         }
-
-        new_row = row;
-        new_col = col;
+        vec_append(&seeds, (uint64_t)seed);
     }
-    return CENTER;
+    *count = seeds.length;
+    return seeds.items;
 }
 
-void remove_wall(Vec* walls, size_t start, size_t target) {
-    assert(start != target);
-    int row_diff = (start / MAZE_ROWS) - (target / MAZE_ROWS);
-    WallType type = row_diff != 0 ? HORIZONTAL : VERTICAL;
-    // WallType type = row_diff != 0 ? VERTICAL : HORIZONTAL;
-    int col_diff = (start % MAZE_ROWS) - (target % MAZE_ROWS);
-    if (row_diff > 0 || col_diff > 0) {
-        vec_append(walls, wall_init(target, start, type));
-    } else if (row_diff < 0 || col_diff < 0) {
-        vec_append(walls, wall_init(start, target, type));
+// Writes the instrumentation report of the whole run to `path`, if one was
+// asked for
+static void write_report(const char* path, uint64_t start_ns) {
+    if (path == NULL) return;
+    FILE* fp = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "ERROR: Failed to open '%s' for writing\n", path);
+        exit(73); // UNIX sysexit.h error code 73
     }
+    instrument_report(fp, instrument_now_ns() - start_ns);
+    if (fp != stdout) fclose(fp);
 }
 
-void gen_maze(Env* env) {
-    // Random initial cell
-    int row = rand() % MAZE_ROWS;
-    int col = rand() % MAZE_COLS;
-    Cell* current = &env->grid[to_ind(row, col)];
-    // Mark current as visited
-    current->visited = true;
-    // Push random initial cell to the stack
-    stack_push(&env->stack, current);
+static void usage(const char* program) {
+    fprintf(stderr, "Usage: %s [OPTIONS]\n", program);
+    fprintf(stderr, "OPTIONS:\n");
+    fprintf(stderr, "    --width  <cols>    Number of maze columns (default: %d)\n", DEFAULT_MAZE_COLS);
+    fprintf(stderr, "    --height <rows>    Number of maze rows (default: %d)\n", DEFAULT_MAZE_ROWS);
+    fprintf(stderr, "    --algorithm <name> Generation algorithm (default: %s)\n", maze_algorithm_name(ALGO_BACKTRACKER));
+    fprintf(stderr, "                       One of:");
+    for (size_t i = 0; i < ALGO_COUNT; i++) {
+        fprintf(stderr, " %s", maze_algorithm_name((MazeAlgorithm)i));
+    }
+    fprintf(stderr, "\n");
+    fprintf(stderr, "    --seed <n>         Seed for the random generator; the same seed and\n");
+    fprintf(stderr, "                       options always produce the same maze (default: time)\n");
+    fprintf(stderr, "    --threads <n>      Draw bands of the image, and generate tiles of a\n");
+    fprintf(stderr, "                       --tile-size maze, on <n> threads; never changes the\n");
+    fprintf(stderr, "                       maze itself (default: 1)\n");
+    fprintf(stderr, "    --tile-size <n>    Generate the maze as independent tiles of this side\n");
+    fprintf(stderr, "                       length in cells, which can run in parallel. Gives a\n");
+    fprintf(stderr, "                       different maze than no tiles (default: untiled)\n");
+    fprintf(stderr, "    --stream           Render and write the image a band of rows at a time\n");
+    fprintf(stderr, "                       instead of holding all of it in memory. With Eller's\n");
+    fprintf(stderr, "                       algorithm (the default here) rows are rendered as they\n");
+    fprintf(stderr, "                       are generated, so memory only depends on the width\n");
+    fprintf(stderr, "    --output <path>    Where the image is written (default: %s.<format>)\n", DEFAULT_OUTPUT_NAME);
+    fprintf(stderr, "    --format <name>    Image format (default: %s). One of:", image_format_name(FORMAT_PPM));
+    for (size_t i = 0; i < FORMAT_COUNT; i++) {
+        fprintf(stderr, " %s", image_format_name((ImageFormat)i));
+    }
+    fprintf(stderr, "\n");
+    fprintf(stderr, "                       Everything but ppm only stores which pixels are walls\n");
+    fprintf(stderr, "    --mmap             Size the output file up front and draw bands of it in\n");
+    fprintf(stderr, "                       place on --threads threads (not for png)\n");
+    fprintf(stderr, "    --pyramid <name>   Write a Deep Zoom pyramid, <name>.dzi and tiles under\n");
+    fprintf(stderr, "                       <name>_files, on --threads threads instead of one\n");
+    fprintf(stderr, "                       image (format default: %s)\n", image_format_name(FORMAT_PNG));
+    fprintf(stderr, "    --pyramid-tile <px> Side length of the pyramid tiles (default: %d)\n", PYRAMID_TILE_SIZE);
+    fprintf(stderr, "    --crop <x,y,w,h>   Only draw this rectangle of the image, in pixels; just\n");
+    fprintf(stderr, "                       the cells under it are read, and with --load only the\n");
+    fprintf(stderr, "                       header of the file is checked, not all of it\n");
+    fprintf(stderr, "    --crop-cells <row,col,rows,cols>\n");
+    fprintf(stderr, "                       The same for these cells and the walls around them\n");
+    fprintf(stderr, "    --scale <n>        Shrink the image or crop <n> times, shading each pixel\n");
+    fprintf(stderr, "                       by how much of it is wall (default: 1)\n");
+    fprintf(stderr, "    --thumbnails <px,...> Also write the whole maze shrunk to fit each of up\n");
+    fprintf(stderr, "                       to %d sizes, shaded from the cells without drawing it at\n", MAX_THUMBNAILS);
+    fprintf(stderr, "                       full size, as <output>_thumb<px>.<format> or next to\n");
+    fprintf(stderr, "                       every maze of a batch\n");
+    fprintf(stderr, "    --save <path>      Also store the maze itself as a .maze file\n");
+    fprintf(stderr, "    --load <path>      Draw the maze stored in a .maze file instead of\n");
+    fprintf(stderr, "                       generating one; its size comes from the file\n");
+    fprintf(stderr, "    --cell-size <px>   Width and height of the open part of a cell (default: %d)\n",
+            DEFAULT_OPEN_WIDTH);
+    fprintf(stderr, "    --cell-width <px>  Only the width of it\n");
+    fprintf(stderr, "    --cell-height <px> Only the height of it\n");
+    fprintf(stderr, "    --wall-size <px>   Thickness of the walls (default: %d)\n", DEFAULT_BORDER_THICKNESS);
+    fprintf(stderr, "    --wall-color <rgb> Color of the walls as RRGGBB hex (default: %06X)\n", DEFAULT_SOLID);
+    fprintf(stderr, "    --open-color <rgb> Color of the passages as RRGGBB hex (default: %06X)\n", DEFAULT_OPEN);
+    fprintf(stderr, "    --batch <count>    Generate <count> mazes seeded <seed>, <seed>+1, ... on\n");
+    fprintf(stderr, "                       --threads workers, one maze per worker at a time\n");
+    fprintf(stderr, "    --batch-stdin      Like --batch, with one seed per line read from stdin\n");
+    fprintf(stderr, "    --output-dir <dir> Where batch mazes are written (default: %s)\n", DEFAULT_OUTPUT_DIR);
+#ifdef MAZE_INSTRUMENT
+    fprintf(stderr, "    --report <path>    Write counters and phase timings as JSON ('-' for stdout)\n");
+#endif
+    fprintf(stderr, "    --help             Print this message\n");
+}
 
-    int removed = 0;
-    while (env->stack.count > 0) {
-        // Pop cell from the stack
-        current = stack_pop(&env->stack);
-        // Updating the current cell's row and column
-        row = current->id / MAZE_ROWS;
-        col = current->id % MAZE_ROWS;
-        // Unvisited neighbors of the current cell
-        NeighborDir unvisited = unvisited_neighbors(env->grid, row, col);
-        if (unvisited == CENTER) continue;
-        // Push the current cell to the stack
-        stack_push(&env->stack, current);
+static uint64_t parse_seed(const char* program, const char* value) {
+    char* end = NULL;
+    if (value != NULL) {
+        // Base 10 and no clamping, so different seeds never mean the same maze
+        errno = 0;
+        unsigned long long n = strtoull(value, &end, 10);
+        if (*value != '-' && *value != '\0' && *end == '\0' && errno != ERANGE) return (uint64_t)n;
+    }
+    fprintf(stderr, "ERROR: '%s' is not a valid seed\n", value ? value : "");
+    usage(program);
+    exit(64); // UNIX sysexit.h error code 64
+}
 
-        int chosen_row = row;
-        int chosen_col = col;
-        switch (unvisited) {
-            case NORTH: chosen_row = row - 1; break;
-            case SOUTH: chosen_row = row + 1; break;
-            case  WEST: chosen_col = col - 1; break;
-            case  EAST: chosen_col = col + 1; break;
-            default: // CENTER
-                fprintf(stderr, "Unreachable!\n");
-                assert(false);
-                break;
-        }
-        Cell* chosen = &env->grid[to_ind(chosen_row, chosen_col)]; 
-        // Remove wall between current and chosen cell
-        remove_wall(&env->removed_walls, to_ind(row, col), to_ind(chosen_row, chosen_col));
-        removed++;
-        // ---- printf("Wall from [r=%d, c=%d] to [r=%d, c=%d] is\tREMOVED\n", row, col, chosen_row, chosen_col);
-        // Mark chosen cell as visited
-        chosen->visited = true;
-        stack_push(&env->stack, chosen);
+static size_t parse_positive(const char* program, const char* flag, const char* value) {
+    if (value == NULL) {
+        fprintf(stderr, "ERROR: No value provided for '%s'\n", flag);
+        usage(program);
+        exit(64); // UNIX sysexit.h error code 64
     }
+    char* end = NULL;
+    unsigned long long n = strtoull(value, &end, 10);
+    // Cell indices have to fit in a `long` for the neighbor arithmetic
+    if (*value == '-' || *end != '\0' || n == 0 || n > (unsigned long long)LONG_MAX) {
+        fprintf(stderr, "ERROR: '%s' is not a valid value for '%s'\n", value, flag);
+        usage(program);
+        exit(64); // UNIX sysexit.h error code 64
+    }
+    return (size_t)n;
 }
 
-#define SOLID 0x32A852
-#if 1
-#define OPEN 0x0 // BLACK Color
-#else
-#define OPEN 0x2856A1 // BLUE Color
-#endif
+// Accepts RRGGBB with an optional leading '#' or 0x
+static uint32_t parse_color(const char* program, const char* flag, const char* value) {
+    if (value == NULL) {
+        fprintf(stderr, "ERROR: No value provided for '%s'\n", flag);
+        usage(program);
+        exit(64); // UNIX sysexit.h error code 64
+    }
+    const char* digits = value;
+    if (*digits == '#') {
+        digits++;
+    } else if (digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X')) {
+        digits += 2;
+    }
+    char* end = NULL;
+    unsigned long n = strtoul(digits, &end, 16);
+    if (strlen(digits) != 6 || strspn(digits, "0123456789abcdefABCDEF") != 6 || *end != '\0') {
+        fprintf(stderr, "ERROR: '%s' is not a valid color for '%s'\n", value, flag);
+        usage(program);
+        exit(64); // UNIX sysexit.h error code 64
+    }
+    return (uint32_t)n;
+}
 
-#define OPEN_WIDTH 10
-#define OPEN_HEIGHT 10
-#define BORDER_THICKNESS 1
+// Accepts four comma separated numbers, the last two positive
+static void parse_rect(const char* program, const char* flag, const char* value, size_t numbers[4]) {
+    const char* p = value;
+    for (int i = 0; i < 4 && p != NULL; i++) {
+        char* end = NULL;
+        unsigned long long n = strtoull(p, &end, 10);
+        if (*p == '-' || end == p || n > (unsigned long long)LONG_MAX || (i >= 2 && n == 0) ||
+            *end != (i < 3 ? ',' : '\0')) {
+            p = NULL;
+            break;
+        }
+        numbers[i] = (size_t)n;
+        p = end + 1;
+    }
+    if (p == NULL) {
+        fprintf(stderr, "ERROR: '%s' is not a valid value for '%s'\n", value ? value : "", flag);
+        usage(program);
+        exit(64); // UNIX sysexit.h error code 64
+    }
+}
 
-#define IMG_WIDTH (MAZE_COLS * OPEN_WIDTH) + ((MAZE_COLS+1) * BORDER_THICKNESS)
-#define IMG_HEIGHT (MAZE_ROWS * OPEN_HEIGHT) + ((MAZE_ROWS+1) * BORDER_THICKNESS)
+// Accepts up to MAX_THUMBNAILS comma separated positive numbers
+static size_t parse_sizes(const char* program, const char* flag, const char* value, size_t sizes[MAX_THUMBNAILS]) {
+    size_t count = 0;
+    const char* p = value;
+    while (p != NULL) {
+        char* end = NULL;
+        unsigned long long n = strtoull(p, &end, 10);
+        if (count == MAX_THUMBNAILS || *p == '-' || end == p || n == 0 || n > (unsigned long long)LONG_MAX ||
+            (*end != ',' && *end != '\0')) {
+            p = NULL;
+            count = 0;
+            break;
+        }
+        sizes[count++] = (size_t)n;
+        p = *end == ',' ? end + 1 : NULL;
+    }
+    if (count == 0) {
+        fprintf(stderr, "ERROR: '%s' is not a valid value for '%s'\n", value ? value : "", flag);
+        usage(program);
+        exit(64); // UNIX sysexit.h error code 64
+    }
+    return count;
+}
 
+// <output>_thumb<size>.<format>, dropping the extension of <output>
+static void thumbnail_path(char* path, size_t path_size, const char* output, size_t size, ImageFormat format) {
+    const char* slash = strrchr(output, '/');
+    const char* dot = strrchr(output, '.');
+    int stem = dot != NULL && (slash == NULL || dot > slash + 1) ? (int)(dot - output) : (int)strlen(output);
+    snprintf(path, path_size, "%.*s_thumb%zu.%s", stem, output, size, image_format_name(format));
+}
 
-void fill_rect(uint32_t (*pixels)[IMG_WIDTH], size_t rx, size_t ry, size_t rw, size_t rh, uint32_t color) {
-    assert(rx + rw <= IMG_WIDTH);
-    assert(ry + rh <= IMG_HEIGHT);
-    for (size_t y = ry; y < (ry + rh); y++) {
-        for (size_t x = rx; x < (rx + rw); x++) {
-            pixels[y][x] = color;
-        }
+// Frees a generated maze or unmaps a loaded one
+static void release_maze(Maze* maze, MappedMazeFile* loaded) {
+    if (loaded->mapping != NULL) {
+        maze_file_unmap(loaded);
+    } else {
+        maze_deinit(maze);
     }
 }
 
-void init_maze(uint32_t (*pixels)[IMG_WIDTH]) {
-    Env env = env_init();
-    gen_maze(&env);
-    size_t y, x;
-    for (size_t r = 0; r < MAZE_ROWS; r++) {
-        for (size_t c = 0; c <= MAZE_COLS; c++) {
-            y = (r * OPEN_HEIGHT) + (r * BORDER_THICKNESS);
-            x = (c * OPEN_WIDTH) + (c * BORDER_THICKNESS);
-            fill_rect(pixels, x, y, BORDER_THICKNESS, OPEN_HEIGHT + (2*BORDER_THICKNESS), SOLID);
+int main(int argc, char** argv) {
+    const char* program = argv[0];
+    size_t rows = DEFAULT_MAZE_ROWS;
+    size_t cols = DEFAULT_MAZE_COLS;
+    MazeAlgorithm algo = ALGO_BACKTRACKER;
+    bool algo_given = false;
+    bool stream = false;
+    bool mapped = false;
+    size_t threads = 1;
+    // Only used once --tile-size asks for tiles
+    size_t tile_size = 0;
+    bool tiled = false;
+    uint64_t seed = (uint64_t)time(NULL);
+    size_t batch = 0;
+    bool batch_stdin = false;
+    const char* output = NULL;
+    ImageFormat format = FORMAT_PPM;
+    bool format_given = false;
+    const char* pyramid = NULL;
+    // x, y, width, height in pixels, or row, col, rows, cols in cells
+    size_t crop[4] = {0};
+    bool crop_given = false;
+    bool crop_cells = false;
+    size_t scale = 1;
+    size_t thumbnails[MAX_THUMBNAILS];
+    size_t thumbnail_count = 0;
+    size_t pyramid_tile = PYRAMID_TILE_SIZE;
+    const char* output_dir = DEFAULT_OUTPUT_DIR;
+    const char* report = NULL;
+    const char* save = NULL;
+    const char* load = NULL;
+    RenderStyle style = DEFAULT_RENDER_STYLE;
+    uint64_t start_ns = instrument_now_ns();
+    for (int i = 1; i < argc; i++) {
+        const char* flag = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(flag, "--width") == 0) {
+            cols = parse_positive(program, flag, value);
+            i++;
+        } else if (strcmp(flag, "--height") == 0) {
+            rows = parse_positive(program, flag, value);
+            i++;
+        } else if (strcmp(flag, "--algorithm") == 0) {
+            if (value == NULL || !maze_algorithm_from_name(value, &algo)) {
+                fprintf(stderr, "ERROR: '%s' is not a known algorithm\n", value ? value : "");
+                usage(program);
+                return 64; // UNIX sysexit.h error code 64
+            }
+            algo_given = true;
+            i++;
+        } else if (strcmp(flag, "--seed") == 0) {
+            seed = parse_seed(program, value);
+            i++;
+        } else if (strcmp(flag, "--threads") == 0) {
+            threads = parse_positive(program, flag, value);
+            i++;
+        } else if (strcmp(flag, "--tile-size") == 0) {
+            tile_size = parse_positive(program, flag, value);
+            tiled = true;
+            i++;
+        } else if (strcmp(flag, "--cell-size") == 0) {
+            style.open_width = style.open_height = parse_positive(program, flag, value);
+            i++;
+        } else if (strcmp(flag, "--cell-width") == 0) {
+            style.open_width = parse_positive(program, flag, value);
+            i++;
+        } else if (strcmp(flag, "--cell-height") == 0) {
+            style.open_height = parse_positive(program, flag, value);
+            i++;
+        } else if (strcmp(flag, "--wall-size") == 0) {
+            style.border = parse_positive(program, flag, value);
+            i++;
+        } else if (strcmp(flag, "--wall-color") == 0) {
+            style.solid = parse_color(program, flag, value);
+            i++;
+        } else if (strcmp(flag, "--open-color") == 0) {
+            style.open = parse_color(program, flag, value);
+            i++;
+        } else if (strcmp(flag, "--batch") == 0) {
+            batch = parse_positive(program, flag, value);
+            i++;
+        } else if (strcmp(flag, "--batch-stdin") == 0) {
+            batch_stdin = true;
+        } else if (strcmp(flag, "--output") == 0) {
+            if (value == NULL) {
+                fprintf(stderr, "ERROR: No value provided for '%s'\n", flag);
+                usage(program);
+                return 64; // UNIX sysexit.h error code 64
+            }
+            output = value;
+            i++;
+        } else if (strcmp(flag, "--format") == 0) {
+            if (value == NULL || !image_format_from_name(value, &format)) {
+                fprintf(stderr, "ERROR: '%s' is not a known image format\n", value ? value : "");
+                usage(program);
+                return 64; // UNIX sysexit.h error code 64
+            }
+            format_given = true;
+            i++;
+        } else if (strcmp(flag, "--pyramid") == 0) {
+            if (value == NULL) {
+                fprintf(stderr, "ERROR: No value provided for '%s'\n", flag);
+                usage(program);
+                return 64; // UNIX sysexit.h error code 64
+            }
+            pyramid = value;
+            i++;
+        } else if (strcmp(flag, "--pyramid-tile") == 0) {
+            pyramid_tile = parse_positive(program, flag, value);
+            i++;
+        } else if (strcmp(flag, "--crop") == 0 || strcmp(flag, "--crop-cells") == 0) {
+            if (value == NULL) {
+                fprintf(stderr, "ERROR: No value provided for '%s'\n", flag);
+                usage(program);
+                return 64; // UNIX sysexit.h error code 64
+            }
+            parse_rect(program, flag, value, crop);
+            crop_given = true;
+            crop_cells = strcmp(flag, "--crop-cells") == 0;
+            i++;
+        } else if (strcmp(flag, "--thumbnails") == 0) {
+            if (value == NULL) {
+                fprintf(stderr, "ERROR: No value provided for '%s'\n", flag);
+                usage(program);
+                return 64; // UNIX sysexit.h error code 64
+            }
+            thumbnail_count = parse_sizes(program, flag, value, thumbnails);
+            i++;
+        } else if (strcmp(flag, "--scale") == 0) {
+            scale = parse_positive(program, flag, value);
+            i++;
+        } else if (strcmp(flag, "--save") == 0 || strcmp(flag, "--load") == 0) {
+            if (value == NULL) {
+                fprintf(stderr, "ERROR: No value provided for '%s'\n", flag);
+                usage(program);
+                return 64; // UNIX sysexit.h error code 64
+            }
+            *(strcmp(flag, "--save") == 0 ? &save : &load) = value;
+            i++;
+        } else if (strcmp(flag, "--output-dir") == 0) {
+            if (value == NULL) {
+                fprintf(stderr, "ERROR: No value provided for '%s'\n", flag);
+                usage(program);
+                return 64; // UNIX sysexit.h error code 64
+            }
+            output_dir = value;
+            i++;
+        } else if (strcmp(flag, "--report") == 0) {
+#ifdef MAZE_INSTRUMENT
+            if (value == NULL) {
+                fprintf(stderr, "ERROR: No value provided for '%s'\n", flag);
+                usage(program);
+                return 64; // UNIX sysexit.h error code 64
+            }
+            report = value;
+            i++;
+#else
+            fprintf(stderr, "ERROR: '%s' needs a build with -DMAZE_INSTRUMENT (make instrument)\n", flag);
+            return 64; // UNIX sysexit.h error code 64
+#endif
+        } else if (strcmp(flag, "--mmap") == 0) {
+            mapped = true;
+        } else if (strcmp(flag, "--stream") == 0) {
+            stream = true;
+        } else if (strcmp(flag, "--help") == 0) {
+            usage(program);
+            return 0;
+        } else {
+            fprintf(stderr, "ERROR: Unknown option '%s'\n", flag);
+            usage(program);
+            return 64; // UNIX sysexit.h error code 64
         }
     }
-
-    for (size_t r = 0; r <= MAZE_ROWS; r++) {
-        for (size_t c = 0; c < MAZE_COLS; c++) {
-            y = (r * OPEN_HEIGHT) + (r * BORDER_THICKNESS);
-            x = (c * OPEN_WIDTH) + (c * BORDER_THICKNESS);
-            fill_rect(pixels, x, y, OPEN_WIDTH + (2*BORDER_THICKNESS), BORDER_THICKNESS, SOLID);
+    // Sizes are positive and colors valid by now, so only equal colors are left
+    if (!render_set_style(style)) {
+        fprintf(stderr, "ERROR: Walls and passages need different colors\n");
+        return 64; // UNIX sysexit.h error code 64
+    }
+    if (pyramid != NULL) {
+        if (stream || mapped || batch > 0 || batch_stdin) {
+            fprintf(stderr, "ERROR: --pyramid can not be combined with --stream, --mmap or batch mode\n");
+            return 64; // UNIX sysexit.h error code 64
+        }
+        if (pyramid_tile > INT32_MAX) {
+            fprintf(stderr, "ERROR: '%zu' is not a valid value for '--pyramid-tile'\n", pyramid_tile);
+            return 64; // UNIX sysexit.h error code 64
         }
+        if (!format_given) format = FORMAT_PNG;
+    }
+    bool cropped = crop_given || scale > 1;
+    if (cropped && (stream || mapped || batch > 0 || batch_stdin || pyramid != NULL)) {
+        fprintf(stderr, "ERROR: --crop and --scale can not be combined with --stream, --mmap, --pyramid or "
+                        "batch mode\n");
+        return 64; // UNIX sysexit.h error code 64
+    }
+    // Batch mazes are named after their index in --output-dir and generated
+    // in one piece each
+    if ((tiled || output != NULL) && (batch > 0 || batch_stdin)) {
+        fprintf(stderr, "ERROR: --tile-size and --output only work for single mazes\n");
+        return 64; // UNIX sysexit.h error code 64
+    }
+    char default_output[64];
+    if (output == NULL) {
+        snprintf(default_output, sizeof(default_output), "%s.%s", DEFAULT_OUTPUT_NAME, image_format_name(format));
+        output = default_output;
+    }
+    if ((save != NULL || load != NULL) && (batch > 0 || batch_stdin)) {
+        fprintf(stderr, "ERROR: --save and --load only work for single mazes\n");
+        return 64; // UNIX sysexit.h error code 64
+    }
+    MappedMazeFile loaded = {0};
+    if (load != NULL) {
+        // A crop should cost what it shows, so the cells are not all read
+        // up front to check them, unless thumbnails read them all anyway
+        loaded = maze_file_map(load, !crop_given || thumbnail_count > 0);
+        rows = loaded.maze.rows;
+        cols = loaded.maze.cols;
+    }
+    if (cols > (SIZE_MAX - render_style.border) / (render_style.open_width + render_style.border) ||
+        rows > (SIZE_MAX - render_style.border) / CELL_ROW_HEIGHT) {
+        fprintf(stderr, "ERROR: A %zux%zu maze is too large to address\n", cols, rows);
+        return 64; // UNIX sysexit.h error code 64
+    }
+    // Every renderer holds at least one band of pixels as wide as the image
+    // and one row of cells high
+    if (CELL_ROW_HEIGHT > SIZE_MAX / image_width(cols)) {
+        fprintf(stderr, "ERROR: Rows of cells %zu pixels high are too large to address for a %zux%zu maze\n",
+                CELL_ROW_HEIGHT, cols, rows);
+        return 64; // UNIX sysexit.h error code 64
     }
 
-    for (size_t i = 0; i < env.removed_walls.length; i++) {
-        size_t target[2] = {
-            env.removed_walls.items[i].target / MAZE_ROWS,
-            env.removed_walls.items[i].target % MAZE_ROWS
+    if (mapped && (stream || batch > 0 || batch_stdin || format == FORMAT_PNG)) {
+        fprintf(stderr, "ERROR: --mmap only works for single ppm, pgm or pbm images\n");
+        return 64; // UNIX sysexit.h error code 64
+    }
+    if (stream) {
+        if (batch > 0 || batch_stdin) {
+            fprintf(stderr, "ERROR: --stream can not be combined with batch mode\n");
+            return 64; // UNIX sysexit.h error code 64
+        }
+        if (!algo_given) algo = ALGO_ELLER;
+        // Thumbnails need the whole grid too
+        if (algo == ALGO_ELLER && !tiled && save == NULL && load == NULL && thumbnail_count == 0) {
+            stream_maze(rows, cols, seed, output, format);
+            write_report(report, start_ns);
+            return 0;
+        }
+        // Every other algorithm needs the whole grid, but not the image
+    }
+    if (rows > SIZE_MAX / cols) {
+        fprintf(stderr, "ERROR: A %zux%zu maze is too large to address\n", cols, rows);
+        return 64; // UNIX sysexit.h error code 64
+    }
+    ImageRect rect = { 0, 0, image_width(cols), image_height(rows) };
+    if (crop_given && crop_cells) {
+        if (crop[0] + crop[2] > rows || crop[1] + crop[3] > cols) {
+            fprintf(stderr, "ERROR: The crop is outside the %zux%zu maze\n", cols, rows);
+            return 64; // UNIX sysexit.h error code 64
+        }
+        rect = image_rect_of_cells(crop[0], crop[1], crop[2], crop[3]);
+    } else if (crop_given) {
+        if (crop[0] + crop[2] > rect.width || crop[1] + crop[3] > rect.height) {
+            fprintf(stderr, "ERROR: The crop is outside the %zux%zu image\n", rect.width, rect.height);
+            return 64; // UNIX sysexit.h error code 64
+        }
+        rect = (ImageRect) { crop[0], crop[1], crop[2], crop[3] };
+    }
+    if (batch > 0 || batch_stdin) {
+        BatchJob job = {
+            .rows = rows,
+            .cols = cols,
+            .algo = algo,
+            .format = format,
+            .output_dir = output_dir,
+            .thumbnails = thumbnails,
+            .thumbnail_count = thumbnail_count,
         };
-        switch (env.removed_walls.items[i].type) {
-            case VERTICAL:
-                fill_rect(pixels,
-                    target[1] * OPEN_WIDTH + target[1] * BORDER_THICKNESS, 
-                    target[0] * OPEN_HEIGHT + target[0] * BORDER_THICKNESS + BORDER_THICKNESS,
-                    BORDER_THICKNESS, OPEN_HEIGHT, OPEN);
-                break;
-            case HORIZONTAL:
-                fill_rect(pixels,
-                    target[1] * OPEN_WIDTH + target[1] * BORDER_THICKNESS + BORDER_THICKNESS,
-                    target[0] * OPEN_HEIGHT + target[0] * BORDER_THICKNESS,
-                    OPEN_WIDTH, BORDER_THICKNESS, OPEN);
-                break;
-            default: break;
+        uint64_t* seeds = NULL;
+        if (batch_stdin) {
+            seeds = read_seeds(stdin, &job.count);
+        } else {
+            if (seed > UINT64_MAX - (batch - 1)) {
+                fprintf(stderr, "ERROR: Seeds %llu and the %zu after it do not fit in 64 bits\n",
+                        (unsigned long long)seed, batch - 1);
+                return 64; // UNIX sysexit.h error code 64
+            }
+            job.count = batch;
+            seeds = (uint64_t*)alloc_or_die(batch, sizeof(uint64_t), "the batch seeds");
+            for (size_t i = 0; i < batch; i++) seeds[i] = seed + i;
         }
+        job.seeds = seeds;
+        run_batch(&job, threads);
+        free(seeds);
+        write_report(report, start_ns);
+        return 0;
     }
-    env_deinit(&env);
-}
-
-void save_as_ppm(uint32_t (*pixels)[IMG_WIDTH], const char* filename) {
-    FILE* fp = fopen(filename, "w");
-    if (fp == NULL) {
-        fprintf(stderr, "ERROR: Failed to open '%s' for writing\n", filename);
-        exit(72); // UNIX sysexit.h error code 72
+    Maze maze = {0};
+    if (load != NULL) {
+        maze = loaded.maze;
+    } else {
+        INSTR_PHASE_BEGIN(generate);
+        // Tiled output only depends on the tile size, never the number of
+        // threads, so only asking for tiles switches to it
+        if (tiled) {
+            maze = maze_init(rows, cols);
+            gen_maze_tiled(&maze, algo, threads, tile_size, seed);
+        } else {
+            Env env = env_init(rows, cols, seed);
+            gen_maze(&env, algo);
+            env_deinit(&env);
+            maze = env.maze;
+        }
+        INSTR_PHASE_END(PHASE_GENERATE, generate);
+        INSTR_ADD(mazes, 1);
     }
-
-    fprintf(fp, "P6\n%d %d 255\n", IMG_WIDTH, IMG_HEIGHT);
-    for (size_t y = 0; y < IMG_HEIGHT; y++) {
-        for (size_t x = 0; x < IMG_WIDTH; x++) {
-            uint32_t pixel = pixels[y][x];
-            // Color HEX code format: 0xRRGGBB
-            uint8_t bytes[3] = {
-                (pixel >> 8*2) & 0xFF, //     0xRR & 0xFF
-                (pixel >> 8*1) & 0xFF, //   0x__GG & 0xFF
-                (pixel >> 8*0) & 0xFF, // 0x____BB & 0xFF
-            };
-            fwrite(bytes, sizeof(bytes), 1, fp);
+    if (save != NULL) {
+        MazeFileInfo info = { .algo = algo, .seed = seed, .tile_size = tile_size };
+        if (load != NULL) info = loaded.info;
+        maze_file_save(save, &maze, &info);
+    }
+    if (thumbnail_count > 0) {
+        size_t path_size = strlen(pyramid != NULL ? pyramid : output) + 64;
+        char* path = (char*)alloc_or_die(path_size, sizeof(char), "the thumbnail path");
+        INSTR_PHASE_BEGIN(rasterize);
+        for (size_t t = 0; t < thumbnail_count; t++) {
+            thumbnail_path(path, path_size, pyramid != NULL ? pyramid : output, thumbnails[t], format);
+            render_thumbnail_to_file(&maze, path, format, thumbnails[t]);
         }
+        INSTR_PHASE_END(PHASE_RASTERIZE, rasterize);
+        free(path);
     }
-
-    fclose(fp);
-}
-
-int main(void) {
-    uint32_t pixels[IMG_HEIGHT][IMG_WIDTH] = {0};
-    srand(time(NULL));
-    init_maze(pixels);
-    save_as_ppm(pixels, "out.ppm");
+    if (pyramid != NULL) {
+        INSTR_PHASE_BEGIN(rasterize);
+        size_t tiles = write_maze_pyramid(&maze, pyramid, pyramid_tile, format, threads);
+        INSTR_PHASE_END(PHASE_RASTERIZE, rasterize);
+        printf("Wrote %zu tiles in %zu levels for '%s.dzi'\n", tiles,
+               pyramid_levels(image_width(cols), image_height(rows)), pyramid);
+        release_maze(&maze, &loaded);
+        write_report(report, start_ns);
+        return 0;
+    }
+    if (cropped) {
+        INSTR_PHASE_BEGIN(rasterize);
+        render_crop_to_file(&maze, output, format, rect, scale);
+        INSTR_PHASE_END(PHASE_RASTERIZE, rasterize);
+        release_maze(&maze, &loaded);
+        write_report(report, start_ns);
+        return 0;
+    }
+    if (mapped) {
+        INSTR_PHASE_BEGIN(rasterize);
+        render_maze_to_mapped_file(&maze, output, format, threads);
+        INSTR_PHASE_END(PHASE_RASTERIZE, rasterize);
+        release_maze(&maze, &loaded);
+        write_report(report, start_ns);
+        return 0;
+    }
+    // Formats without color are drawn from the grid without an RGB image
+    if (stream || format != FORMAT_PPM) {
+        stream_maze_to_file(&maze, output, format);
+        release_maze(&maze, &loaded);
+        write_report(report, start_ns);
+        return 0;
+    }
+    Image img = image_init(rows, cols);
+    INSTR_PHASE_BEGIN(rasterize);
+    render_maze_threaded(&img, &maze, threads);
+    INSTR_PHASE_END(PHASE_RASTERIZE, rasterize);
+    release_maze(&maze, &loaded);
+    INSTR_PHASE_BEGIN(encode);
+    save_image(&img, output, format);
+    INSTR_PHASE_END(PHASE_ENCODE, encode);
+    image_deinit(&img);
+    write_report(report, start_ns);
     return 0;
 }
@@ -0,0 +1,90 @@
+// Opt-in counters and phase timings
+//
+// Build with -DMAZE_INSTRUMENT to collect them; otherwise every INSTR_* macro
+// compiles away and the hot paths are unchanged. Disabled counters still
+// evaluate their argument (and throw it away) so values computed only for a
+// counter do not trigger unused variable warnings. The counters are global
+// and updated atomically, so threads can share them.
+//
+// Define INSTRUMENT_H_IMPLEMENTATION in exactly one file before including
+// this header to get the function definitions.
+#ifndef INSTRUMENT_H_
+#define INSTRUMENT_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+typedef enum {
+    PHASE_GENERATE,
+    PHASE_RASTERIZE,
+    PHASE_ENCODE,
+    PHASE_COUNT,
+} Phase;
+
+typedef struct {
+    // Summed over threads, so with several workers this is CPU time
+    uint64_t phase_ns[PHASE_COUNT];
+    uint64_t mazes;
+    uint64_t walls_removed;
+    uint64_t peak_dfs_depth;
+    uint64_t stack_reallocs;
+    uint64_t vec_reallocs;
+    uint64_t bytes_written;
+} Instrument;
+
+extern Instrument instrument;
+
+static inline uint64_t instrument_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static inline void instrument_max(uint64_t* counter, uint64_t value) {
+    uint64_t seen = __atomic_load_n(counter, __ATOMIC_RELAXED);
+    while (value > seen &&
+           !__atomic_compare_exchange_n(counter, &seen, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+#ifdef MAZE_INSTRUMENT
+    #define INSTR_ADD(counter, n) __atomic_fetch_add(&instrument.counter, (uint64_t)(n), __ATOMIC_RELAXED)
+    #define INSTR_MAX(counter, value) instrument_max(&instrument.counter, (uint64_t)(value))
+    #define INSTR_PHASE_BEGIN(var) uint64_t var = instrument_now_ns()
+    #define INSTR_PHASE_END(phase, var) INSTR_ADD(phase_ns[phase], instrument_now_ns() - (var))
+#else
+    #define INSTR_ADD(counter, n) ((void)(n))
+    #define INSTR_MAX(counter, value) ((void)(value))
+    #define INSTR_PHASE_BEGIN(var) ((void)0)
+    #define INSTR_PHASE_END(phase, var) ((void)0)
+#endif
+
+// Writes every counter as one JSON object; `wall_ns` is the elapsed time of
+// the whole run
+void instrument_report(FILE* fp, uint64_t wall_ns);
+
+#endif // INSTRUMENT_H_
+
+#if defined(INSTRUMENT_H_IMPLEMENTATION) && !defined(INSTRUMENT_H_IMPLEMENTED)
+#define INSTRUMENT_H_IMPLEMENTED
+Instrument instrument = {0};
+
+void instrument_report(FILE* fp, uint64_t wall_ns) {
+    static const char* phase_names[PHASE_COUNT] = { "generate", "rasterize", "encode" };
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"wall_ms\": %.3f,\n", wall_ns / 1e6);
+    fprintf(fp, "  \"phase_ms\": {");
+    for (size_t p = 0; p < PHASE_COUNT; p++) {
+        fprintf(fp, "%s\"%s\": %.3f", p > 0 ? ", " : " ", phase_names[p], instrument.phase_ns[p] / 1e6);
+    }
+    fprintf(fp, " },\n");
+    fprintf(fp, "  \"mazes\": %llu,\n", (unsigned long long)instrument.mazes);
+    fprintf(fp, "  \"walls_removed\": %llu,\n", (unsigned long long)instrument.walls_removed);
+    fprintf(fp, "  \"peak_dfs_depth\": %llu,\n", (unsigned long long)instrument.peak_dfs_depth);
+    fprintf(fp, "  \"stack_reallocs\": %llu,\n", (unsigned long long)instrument.stack_reallocs);
+    fprintf(fp, "  \"vec_reallocs\": %llu,\n", (unsigned long long)instrument.vec_reallocs);
+    fprintf(fp, "  \"bytes_written\": %llu\n", (unsigned long long)instrument.bytes_written);
+    fprintf(fp, "}\n");
+}
+#endif // INSTRUMENT_H_IMPLEMENTATION
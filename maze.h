@@ -0,0 +1,984 @@
+// Maze grid and generation algorithms
+//
+// Define MAZE_H_IMPLEMENTATION in exactly one file before including this
+// header to get the function definitions.
+#ifndef MAZE_H_
+#define MAZE_H_
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifdef MAZE_H_IMPLEMENTATION
+    #define RNG_H_IMPLEMENTATION
+#endif
+#include "rng.h"
+
+#ifdef MAZE_H_IMPLEMENTATION
+    #define INSTRUMENT_H_IMPLEMENTATION
+#endif
+#include "instrument.h"
+
+#define to_ind(maze, r, c) ((r) * (maze)->cols + (c))
+
+typedef enum {
+    NORTH,
+    SOUTH,
+    WEST,
+    EAST,
+} NeighborDir;
+
+// Every cell only stores the walls on its east and south side; the north and
+// west walls are owned by the neighbor above/left of it (or the outer border).
+// That makes a perfect maze two bits per cell, packed four cells to a byte.
+#define CELL_EAST_OPEN  0x1
+#define CELL_SOUTH_OPEN 0x2
+#define CELL_BITS 2
+#define CELLS_PER_BYTE (8 / CELL_BITS)
+
+typedef struct {
+    size_t rows;
+    size_t cols;
+    uint8_t* cells;
+} Maze;
+
+#ifdef MAZE_H_IMPLEMENTATION
+    #define STACK_H_IMPLEMENTATION
+#endif
+#define STACK_TYPE size_t
+#define STACK_NAME CellStack
+#define STACK_PREFIX cell_stack
+#include "stack.h"
+
+#ifdef MAZE_H_IMPLEMENTATION
+    #define STACK_H_IMPLEMENTATION
+#endif
+#define STACK_TYPE uint8_t
+#define STACK_NAME ByteStack
+#define STACK_PREFIX byte_stack
+#include "stack.h"
+
+// A path through the maze as the NeighborDir taken at every step, packed
+// four to a byte
+typedef struct {
+    ByteStack bytes;
+    size_t count;
+} DirStack;
+
+// Scratch state that only lives for the duration of a generation
+typedef struct {
+    Maze maze;
+    // One bit per cell, with a one cell wide border that is always marked
+    // visited so neighbor lookups never have to check bounds
+    uint8_t* visited;
+    CellStack stack;
+    // Backtracker path back to the starting cell
+    DirStack path;
+    Rng rng;
+} Env;
+
+typedef enum {
+    ALGO_BACKTRACKER,
+    ALGO_STACKLESS_BACKTRACKER,
+    ALGO_BINARY_TREE,
+    ALGO_SIDEWINDER,
+    ALGO_ELLER,
+    ALGO_HUNT_AND_KILL,
+    ALGO_KRUSKAL,
+    ALGO_PRIM,
+    ALGO_WILSON,
+    ALGO_COUNT,
+} MazeAlgorithm;
+
+typedef void (*MazeGenerator)(Env* env);
+
+typedef struct {
+    const char* name;
+    MazeGenerator generate;
+} MazeAlgorithmInfo;
+
+extern const MazeAlgorithmInfo maze_algorithms[ALGO_COUNT];
+
+// Eller's algorithm only ever looks at one row, so its state is kept apart
+// from `Env` and sized by the column count alone
+typedef struct {
+    size_t cols;
+    uint32_t* sets;
+    uint32_t* next_sets;
+    uint32_t* parent;
+    uint32_t* count;
+    uint32_t* free_labels;
+    uint8_t* went_down;
+    Rng rng;
+} EllerRow;
+
+Maze maze_init(size_t rows, size_t cols);
+void maze_deinit(Maze* maze);
+// Wall bits (CELL_EAST_OPEN | CELL_SOUTH_OPEN) of a single cell
+static inline uint8_t maze_cell(const Maze* maze, size_t ind);
+static inline void maze_open(Maze* maze, size_t ind, uint8_t walls);
+void remove_wall(Maze* maze, size_t start, size_t target);
+
+Env env_init(size_t rows, size_t cols, uint64_t seed);
+// Clears a used Env for another generation of the same size, keeping every
+// buffer it already allocated
+void env_reset(Env* env, uint64_t seed);
+void env_deinit(Env* env);
+
+const char* maze_algorithm_name(MazeAlgorithm algo);
+// Returns false when `name` is not a known algorithm
+bool maze_algorithm_from_name(const char* name, MazeAlgorithm* algo);
+void gen_maze(Env* env, MazeAlgorithm algo);
+
+void gen_maze_backtracker(Env* env);
+void gen_maze_stackless_backtracker(Env* env);
+void gen_maze_binary_tree(Env* env);
+void gen_maze_sidewinder(Env* env);
+void gen_maze_eller(Env* env);
+void gen_maze_hunt_and_kill(Env* env);
+void gen_maze_kruskal(Env* env);
+void gen_maze_prim(Env* env);
+void gen_maze_wilson(Env* env);
+
+// Splits the grid into `tile_size` x `tile_size` tiles generated in parallel
+// on `threads` threads, then joins the tiles through one random opening per
+// edge of a spanning tree over the tile grid, so the result is still perfect.
+// Each tile draws from its own random stream, so the maze only depends on the
+// seed and tile size and not on the number of threads.
+void gen_maze_tiled(Maze* maze, MazeAlgorithm algo, size_t threads, size_t tile_size, uint64_t seed);
+
+// Runs `fn(job)` on `threads` threads at once, the calling thread being one
+// of them, and returns when all are done. The workers share `job` and take
+// their next piece of work from it.
+void run_workers(void* (*fn)(void*), void* job, size_t threads);
+
+EllerRow eller_init(size_t cols, uint64_t seed);
+// Carves one row, writing the wall bits of every cell into `walls[0..cols)`.
+// The last row has to be flagged so every remaining set gets joined.
+void eller_next_row(EllerRow* row, uint8_t* walls, bool last);
+void eller_deinit(EllerRow* row);
+
+static inline uint8_t maze_cell(const Maze* maze, size_t ind) {
+    size_t shift = (ind % CELLS_PER_BYTE) * CELL_BITS;
+    return (maze->cells[ind / CELLS_PER_BYTE] >> shift) & ((1 << CELL_BITS) - 1);
+}
+
+static inline void maze_open(Maze* maze, size_t ind, uint8_t walls) {
+    size_t shift = (ind % CELLS_PER_BYTE) * CELL_BITS;
+    maze->cells[ind / CELLS_PER_BYTE] |= walls << shift;
+    INSTR_ADD(walls_removed, __builtin_popcount(walls));
+}
+
+static void* alloc_or_die(size_t count, size_t size, const char* what) {
+    void* ptr = calloc(count, size);
+    if (ptr == NULL) {
+        fprintf(stderr, "ERROR: Failed to allocate %s\n", what);
+        exit(71); // UNIX sysexit.h error code 71
+    }
+    return ptr;
+}
+
+#endif // MAZE_H_
+
+// Guarded separately so other headers can include this one again
+#if defined(MAZE_H_IMPLEMENTATION) && !defined(MAZE_H_IMPLEMENTED)
+#define MAZE_H_IMPLEMENTED
+Maze maze_init(size_t rows, size_t cols) {
+    assert(rows > 0 && cols > 0);
+    Maze maze = {0};
+    maze.rows = rows;
+    maze.cols = cols;
+    // Every wall starts out closed
+    maze.cells = (uint8_t*)alloc_or_die((rows * cols + CELLS_PER_BYTE - 1) / CELLS_PER_BYTE,
+                                        sizeof(uint8_t), "the maze grid");
+    return maze;
+}
+
+void maze_deinit(Maze* maze) {
+    free(maze->cells);
+    maze->cells = NULL;
+}
+
+#define padded_cells(maze) (((maze)->rows + 2) * ((maze)->cols + 2))
+
+static inline bool visited_bit(const Env* env, size_t padded) {
+    return (env->visited[padded / 8] >> (padded % 8)) & 1;
+}
+
+static inline void set_visited_bit(Env* env, size_t padded) {
+    env->visited[padded / 8] |= 1 << (padded % 8);
+}
+
+// Position of cell `ind` in the padded visited bitmap
+static inline size_t visited_ind(const Maze* maze, size_t ind) {
+    return ind + (ind / maze->cols) * 2 + maze->cols + 3;
+}
+
+static void mark_border_visited(Env* env) {
+    size_t stride = env->maze.cols + 2;
+    size_t last_row = (env->maze.rows + 1) * stride;
+    for (size_t c = 0; c < stride; c++) {
+        set_visited_bit(env, c);
+        set_visited_bit(env, last_row + c);
+    }
+    for (size_t r = 1; r <= env->maze.rows; r++) {
+        set_visited_bit(env, r * stride);
+        set_visited_bit(env, r * stride + stride - 1);
+    }
+}
+
+Env env_init(size_t rows, size_t cols, uint64_t seed) {
+    Env env = {0};
+    env.rng = rng_init(seed);
+    env.maze = maze_init(rows, cols);
+    env.visited = (uint8_t*)alloc_or_die((padded_cells(&env.maze) + 7) / 8, sizeof(uint8_t), "the visited bitmap");
+    mark_border_visited(&env);
+    env.stack = cell_stack_init();
+    env.path = (DirStack) { .bytes = byte_stack_init(), .count = 0 };
+    return env;
+}
+
+void env_reset(Env* env, uint64_t seed) {
+    size_t cells = env->maze.rows * env->maze.cols;
+    memset(env->maze.cells, 0, (cells + CELLS_PER_BYTE - 1) / CELLS_PER_BYTE);
+    memset(env->visited, 0, (padded_cells(&env->maze) + 7) / 8);
+    mark_border_visited(env);
+    cell_stack_clear(&env->stack);
+    byte_stack_clear(&env->path.bytes);
+    env->path.count = 0;
+    env->rng = rng_init(seed);
+}
+
+void env_deinit(Env* env) {
+    free(env->visited);
+    env->visited = NULL;
+    cell_stack_deinit(&env->stack);
+    byte_stack_deinit(&env->path.bytes);
+    env->path.count = 0;
+}
+
+static inline void dir_stack_push(DirStack* path, uint8_t dir) {
+    size_t shift = (path->count % 4) * 2;
+    if (shift == 0) {
+        byte_stack_push(&path->bytes, dir);
+    } else {
+        path->bytes.items[path->bytes.count - 1] |= dir << shift;
+    }
+    path->count++;
+}
+
+static inline uint8_t dir_stack_pop(DirStack* path) {
+    assert(path->count > 0);
+    path->count--;
+    size_t shift = (path->count % 4) * 2;
+    uint8_t* last = &path->bytes.items[path->bytes.count - 1];
+    uint8_t dir = (*last >> shift) & 3;
+    if (shift == 0) {
+        path->bytes.count--;
+    } else {
+        // Clear the bits so the slot can be OR-ed into again
+        *last &= ~(3 << shift);
+    }
+    return dir;
+}
+
+static inline bool is_visited(const Env* env, size_t ind) {
+    return visited_bit(env, visited_ind(&env->maze, ind));
+}
+
+static inline void mark_visited(Env* env, size_t ind) {
+    set_visited_bit(env, visited_ind(&env->maze, ind));
+}
+
+// In-bound neighbors of a cell, along with where they and the cell itself sit
+// in the padded visited bitmap
+typedef struct {
+    size_t count;
+    size_t self_padded;
+    size_t cells[4];
+    size_t padded[4];
+} Neighbors;
+
+static void maze_neighbors(const Maze* maze, size_t ind, Neighbors* out) {
+    size_t row = ind / maze->cols;
+    size_t col = ind - row * maze->cols;
+    size_t stride = maze->cols + 2;
+    size_t p = ind + row * 2 + stride + 1;
+    size_t n = 0;
+    if (row > 0)              { out->padded[n] = p - stride; out->cells[n++] = ind - maze->cols; }
+    if (row + 1 < maze->rows) { out->padded[n] = p + stride; out->cells[n++] = ind + maze->cols; }
+    if (col > 0)              { out->padded[n] = p - 1;      out->cells[n++] = ind - 1; }
+    if (col + 1 < maze->cols) { out->padded[n] = p + 1;      out->cells[n++] = ind + 1; }
+    out->count = n;
+    out->self_padded = p;
+}
+
+// For every ordering of the four directions (4! = 24 of them) and every mask
+// of unvisited neighbors, the first direction of that ordering in the mask.
+// One random ordering then picks uniformly among the unvisited neighbors.
+static uint8_t dir_choice[24][16];
+static pthread_once_t dir_choice_once = PTHREAD_ONCE_INIT;
+
+static void init_dir_choice(void) {
+    size_t perm = 0;
+    for (uint8_t a = 0; a < 4; a++) {
+        for (uint8_t b = 0; b < 4; b++) {
+            for (uint8_t c = 0; c < 4; c++) {
+                if (a == b || a == c || b == c) continue;
+                uint8_t order[4] = {a, b, c, (uint8_t)(6 - a - b - c)};
+                for (uint8_t mask = 1; mask < 16; mask++) {
+                    for (size_t i = 0; i < 4; i++) {
+                        if ((mask >> order[i]) & 1) {
+                            dir_choice[perm][mask] = order[i];
+                            break;
+                        }
+                    }
+                }
+                perm++;
+            }
+        }
+    }
+    assert(perm == 24);
+}
+
+void remove_wall(Maze* maze, size_t start, size_t target) {
+    assert(start != target);
+    // The wall always belongs to whichever cell is above or to the left
+    size_t first = start < target ? start : target;
+    size_t second = start < target ? target : start;
+    if (second - first == maze->cols) {
+        maze_open(maze, first, CELL_SOUTH_OPEN);
+    } else {
+        assert(second - first == 1 && second % maze->cols != 0);
+        maze_open(maze, first, CELL_EAST_OPEN);
+    }
+}
+
+const MazeAlgorithmInfo maze_algorithms[ALGO_COUNT] = {
+    [ALGO_BACKTRACKER]           = { "backtracker",           gen_maze_backtracker },
+    [ALGO_STACKLESS_BACKTRACKER] = { "stackless-backtracker", gen_maze_stackless_backtracker },
+    [ALGO_BINARY_TREE]           = { "binary-tree",           gen_maze_binary_tree },
+    [ALGO_SIDEWINDER]            = { "sidewinder",            gen_maze_sidewinder },
+    [ALGO_ELLER]                 = { "eller",                 gen_maze_eller },
+    [ALGO_HUNT_AND_KILL]         = { "hunt-and-kill",         gen_maze_hunt_and_kill },
+    [ALGO_KRUSKAL]               = { "kruskal",               gen_maze_kruskal },
+    [ALGO_PRIM]                  = { "prim",                  gen_maze_prim },
+    [ALGO_WILSON]                = { "wilson",                gen_maze_wilson },
+};
+
+const char* maze_algorithm_name(MazeAlgorithm algo) {
+    assert(algo < ALGO_COUNT);
+    return maze_algorithms[algo].name;
+}
+
+bool maze_algorithm_from_name(const char* name, MazeAlgorithm* algo) {
+    for (size_t i = 0; i < ALGO_COUNT; i++) {
+        if (strcmp(maze_algorithms[i].name, name) == 0) {
+            *algo = (MazeAlgorithm)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void gen_maze(Env* env, MazeAlgorithm algo) {
+    assert(algo < ALGO_COUNT);
+    maze_algorithms[algo].generate(env);
+}
+
+// Recursive backtracker: a randomized depth-first search.
+// Instead of cell indices the stack holds the direction of every step, two
+// bits each, and the current position is moved along in both the maze and the
+// padded bitmap, so the loop never divides and backtracking is a single pop.
+void gen_maze_backtracker(Env* env) {
+    Maze* maze = &env->maze;
+    pthread_once(&dir_choice_once, init_dir_choice);
+    // Neighbor offsets in NeighborDir order, in the padded visited bitmap and
+    // in the maze itself
+    ptrdiff_t stride = (ptrdiff_t)maze->cols + 2;
+    const ptrdiff_t padded_step[4] = { -stride, stride, -1, 1 };
+    const ptrdiff_t cell_step[4] = { -(ptrdiff_t)maze->cols, (ptrdiff_t)maze->cols, -1, 1 };
+    const uint8_t dir_wall[4] = { CELL_SOUTH_OPEN, CELL_SOUTH_OPEN, CELL_EAST_OPEN, CELL_EAST_OPEN };
+
+    // Random initial cell
+    size_t current = rng_below(&env->rng, maze->rows * maze->cols);
+    size_t padded = visited_ind(maze, current);
+    // Mark current as visited
+    set_visited_bit(env, padded);
+
+    size_t removed = 0;
+    for (;;) {
+        // Unvisited neighbors of the current cell as a NeighborDir bitmask
+        uint8_t unvisited = (!visited_bit(env, padded - stride) << NORTH) |
+                            (!visited_bit(env, padded + stride) << SOUTH) |
+                            (!visited_bit(env, padded - 1) << WEST) |
+                            (!visited_bit(env, padded + 1) << EAST);
+        if (unvisited == 0) {
+            if (env->path.count == 0) break;
+            // Step back the way we came
+            uint8_t dir = dir_stack_pop(&env->path);
+            current -= cell_step[dir];
+            padded -= padded_step[dir];
+            continue;
+        }
+
+        uint8_t dir = dir_choice[rng_below(&env->rng, 24)][unvisited];
+        size_t chosen = current + cell_step[dir];
+        // Remove wall between current and chosen cell. Going north or west
+        // the wall belongs to the chosen cell, otherwise to the current one.
+        maze_open(maze, (dir == NORTH || dir == WEST) ? chosen : current, dir_wall[dir]);
+        removed++;
+        // Mark chosen cell as visited and move into it
+        current = chosen;
+        padded += padded_step[dir];
+        set_visited_bit(env, padded);
+        dir_stack_push(&env->path, dir);
+        INSTR_MAX(peak_dfs_depth, env->path.count);
+    }
+    assert(removed == maze->rows * maze->cols - 1);
+}
+
+// Whether any of the four walls around an in-bound cell has been opened
+static inline bool has_passage(const Maze* maze, size_t ind, size_t row, size_t col) {
+    if (maze_cell(maze, ind) != 0) return true;
+    if (col > 0 && (maze_cell(maze, ind - 1) & CELL_EAST_OPEN)) return true;
+    if (row > 0 && (maze_cell(maze, ind - maze->cols) & CELL_SOUTH_OPEN)) return true;
+    return false;
+}
+
+// The same depth-first search as `gen_maze_backtracker`, and the same maze
+// for the same seed, without any path stack. The visited bitmap is used to
+// mark cells as finished instead; an unfinished cell is unvisited exactly
+// when no passage leads into it yet. When a cell runs out of unvisited
+// neighbors all of its children are finished, so the way back is the one
+// passage out of it that leads to an unfinished cell: its parent.
+void gen_maze_stackless_backtracker(Env* env) {
+    Maze* maze = &env->maze;
+    pthread_once(&dir_choice_once, init_dir_choice);
+    ptrdiff_t stride = (ptrdiff_t)maze->cols + 2;
+    const ptrdiff_t padded_step[4] = { -stride, stride, -1, 1 };
+    const ptrdiff_t cell_step[4] = { -(ptrdiff_t)maze->cols, (ptrdiff_t)maze->cols, -1, 1 };
+    const ptrdiff_t row_step[4] = { -1, 1, 0, 0 };
+    const ptrdiff_t col_step[4] = { 0, 0, -1, 1 };
+    const uint8_t dir_wall[4] = { CELL_SOUTH_OPEN, CELL_SOUTH_OPEN, CELL_EAST_OPEN, CELL_EAST_OPEN };
+
+    size_t start = rng_below(&env->rng, maze->rows * maze->cols);
+    size_t current = start;
+    size_t row = start / maze->cols;
+    size_t col = start % maze->cols;
+    size_t padded = visited_ind(maze, start);
+
+    size_t removed = 0;
+    for (;;) {
+        uint8_t unvisited = 0;
+        for (uint8_t dir = 0; dir < 4; dir++) {
+            // The border is marked finished, so nothing past it is looked at
+            if (visited_bit(env, padded + padded_step[dir])) continue;
+            size_t neighbor = current + cell_step[dir];
+            if (neighbor != start &&
+                !has_passage(maze, neighbor, row + row_step[dir], col + col_step[dir])) {
+                unvisited |= 1 << dir;
+            }
+        }
+
+        if (unvisited != 0) {
+            uint8_t dir = dir_choice[rng_below(&env->rng, 24)][unvisited];
+            size_t chosen = current + cell_step[dir];
+            maze_open(maze, (dir == NORTH || dir == WEST) ? chosen : current, dir_wall[dir]);
+            removed++;
+            current = chosen;
+            padded += padded_step[dir];
+            row += row_step[dir];
+            col += col_step[dir];
+            continue;
+        }
+
+        set_visited_bit(env, padded);
+        if (current == start) break;
+        uint8_t cell = maze_cell(maze, current);
+        bool open[4] = {
+            [NORTH] = row > 0 && (maze_cell(maze, current - maze->cols) & CELL_SOUTH_OPEN),
+            [SOUTH] = cell & CELL_SOUTH_OPEN,
+            [WEST]  = col > 0 && (maze_cell(maze, current - 1) & CELL_EAST_OPEN),
+            [EAST]  = cell & CELL_EAST_OPEN,
+        };
+        uint8_t dir = 0;
+        while (!open[dir] || visited_bit(env, padded + padded_step[dir])) {
+            dir++;
+            assert(dir < 4);
+        }
+        current += cell_step[dir];
+        padded += padded_step[dir];
+        row += row_step[dir];
+        col += col_step[dir];
+    }
+    assert(removed == maze->rows * maze->cols - 1);
+}
+
+// Binary tree: every cell opens either its east or its south wall
+void gen_maze_binary_tree(Env* env) {
+    Maze* maze = &env->maze;
+    for (size_t r = 0; r < maze->rows; r++) {
+        for (size_t c = 0; c < maze->cols; c++) {
+            bool can_east = c + 1 < maze->cols;
+            bool can_south = r + 1 < maze->rows;
+            uint8_t wall = 0;
+            if (can_east && can_south) {
+                wall = rng_below(&env->rng, 2) ? CELL_EAST_OPEN : CELL_SOUTH_OPEN;
+            } else if (can_east) {
+                wall = CELL_EAST_OPEN;
+            } else if (can_south) {
+                wall = CELL_SOUTH_OPEN;
+            }
+            maze_open(maze, to_ind(maze, r, c), wall);
+        }
+    }
+}
+
+// Sidewinder: each row is split into runs of east passages, and every run
+// opens one random cell to the south. The bottom row is a single run.
+void gen_maze_sidewinder(Env* env) {
+    Maze* maze = &env->maze;
+    for (size_t r = 0; r < maze->rows; r++) {
+        bool last_row = r + 1 == maze->rows;
+        size_t run_start = 0;
+        for (size_t c = 0; c < maze->cols; c++) {
+            bool last_col = c + 1 == maze->cols;
+            if (!last_col && (last_row || rng_below(&env->rng, 2))) {
+                maze_open(maze, to_ind(maze, r, c), CELL_EAST_OPEN);
+                continue;
+            }
+            if (!last_row) {
+                size_t chosen = run_start + rng_below(&env->rng, c - run_start + 1);
+                maze_open(maze, to_ind(maze, r, chosen), CELL_SOUTH_OPEN);
+            }
+            run_start = c + 1;
+        }
+    }
+}
+
+EllerRow eller_init(size_t cols, uint64_t seed) {
+    assert(cols > 0 && cols <= UINT32_MAX);
+    EllerRow row = {0};
+    row.cols = cols;
+    row.rng = rng_init(seed);
+    row.sets = (uint32_t*)alloc_or_die(cols, sizeof(uint32_t), "the Eller row");
+    row.next_sets = (uint32_t*)alloc_or_die(cols, sizeof(uint32_t), "the Eller row");
+    row.parent = (uint32_t*)alloc_or_die(cols, sizeof(uint32_t), "the Eller row");
+    row.count = (uint32_t*)alloc_or_die(cols, sizeof(uint32_t), "the Eller row");
+    row.free_labels = (uint32_t*)alloc_or_die(cols, sizeof(uint32_t), "the Eller row");
+    row.went_down = (uint8_t*)alloc_or_die(cols, sizeof(uint8_t), "the Eller row");
+    // Every cell of the first row starts in a set of its own
+    for (size_t c = 0; c < cols; c++) {
+        row.sets[c] = (uint32_t)c;
+    }
+    return row;
+}
+
+void eller_deinit(EllerRow* row) {
+    free(row->sets);
+    free(row->next_sets);
+    free(row->parent);
+    free(row->count);
+    free(row->free_labels);
+    free(row->went_down);
+    *row = (EllerRow) {0};
+}
+
+static uint32_t eller_find(EllerRow* row, uint32_t label) {
+    while (row->parent[label] != label) {
+        row->parent[label] = row->parent[row->parent[label]];
+        label = row->parent[label];
+    }
+    return label;
+}
+
+void eller_next_row(EllerRow* row, uint8_t* walls, bool last) {
+    size_t cols = row->cols;
+    memset(walls, 0, cols);
+    // Set labels always stay below `cols`, so the union-find only needs one
+    // slot per column and is rebuilt for every row
+    for (size_t c = 0; c < cols; c++) {
+        row->parent[c] = (uint32_t)c;
+    }
+
+    // Randomly join adjacent cells that belong to different sets. The last
+    // row joins all of them so the whole maze ends up connected.
+    for (size_t c = 0; c + 1 < cols; c++) {
+        uint32_t a = eller_find(row, row->sets[c]);
+        uint32_t b = eller_find(row, row->sets[c + 1]);
+        if (a != b && (last || rng_below(&row->rng, 2))) {
+            walls[c] |= CELL_EAST_OPEN;
+            row->parent[b] = a;
+        }
+    }
+    if (last) return;
+
+    memset(row->count, 0, sizeof(uint32_t) * cols);
+    memset(row->went_down, 0, cols);
+    for (size_t c = 0; c < cols; c++) {
+        row->sets[c] = eller_find(row, row->sets[c]);
+        row->count[row->sets[c]]++;
+    }
+
+    // Every set has to continue downwards through at least one cell
+    for (size_t c = 0; c < cols; c++) {
+        uint32_t set = row->sets[c];
+        row->count[set]--;
+        if (rng_below(&row->rng, 2) || (row->count[set] == 0 && !row->went_down[set])) {
+            walls[c] |= CELL_SOUTH_OPEN;
+            row->went_down[set] = 1;
+        }
+    }
+
+    // Cells below a south passage inherit the set, the rest get labels no
+    // continuing set is using
+    size_t free_count = 0;
+    for (size_t label = 0; label < cols; label++) {
+        if (!row->went_down[label]) row->free_labels[free_count++] = (uint32_t)label;
+    }
+    for (size_t c = 0; c < cols; c++) {
+        if (walls[c] & CELL_SOUTH_OPEN) {
+            row->next_sets[c] = row->sets[c];
+        } else {
+            assert(free_count > 0);
+            row->next_sets[c] = row->free_labels[--free_count];
+        }
+    }
+    uint32_t* temp = row->sets;
+    row->sets = row->next_sets;
+    row->next_sets = temp;
+}
+
+// Eller's algorithm: builds the maze one row at a time with O(cols) state
+void gen_maze_eller(Env* env) {
+    Maze* maze = &env->maze;
+    EllerRow row = eller_init(maze->cols, rng_next(&env->rng));
+    uint8_t* walls = (uint8_t*)alloc_or_die(maze->cols, sizeof(uint8_t), "the Eller row");
+    for (size_t r = 0; r < maze->rows; r++) {
+        eller_next_row(&row, walls, r + 1 == maze->rows);
+        for (size_t c = 0; c < maze->cols; c++) {
+            maze_open(maze, to_ind(maze, r, c), walls[c]);
+        }
+    }
+    free(walls);
+    eller_deinit(&row);
+}
+
+// Hunt-and-kill: a random walk that, once stuck, restarts from the first
+// unvisited cell next to the visited region
+void gen_maze_hunt_and_kill(Env* env) {
+    Maze* maze = &env->maze;
+    size_t total = maze->rows * maze->cols;
+    // Starting in the top-left corner means the first unvisited cell in
+    // row-major order always has a visited neighbor above or to its left, so
+    // hunting never has to scan past it
+    size_t current = 0;
+    mark_visited(env, current);
+    size_t visited = 1;
+    // Every cell before the cursor is visited. The cursor is tracked in the
+    // padded bitmap too, which skips two border bits at the end of each row.
+    size_t cursor = 0;
+    size_t cursor_col = 0;
+    size_t cursor_padded = visited_ind(maze, 0);
+    Neighbors neighbors;
+    size_t candidates[4];
+    size_t candidates_padded[4];
+
+    while (visited < total) {
+        // Kill: walk randomly until there is nowhere left to go
+        maze_neighbors(maze, current, &neighbors);
+        size_t unvisited = 0;
+        for (size_t i = 0; i < neighbors.count; i++) {
+            if (visited_bit(env, neighbors.padded[i])) continue;
+            candidates[unvisited] = neighbors.cells[i];
+            candidates_padded[unvisited++] = neighbors.padded[i];
+        }
+        if (unvisited > 0) {
+            size_t pick = rng_below(&env->rng, unvisited);
+            remove_wall(maze, current, candidates[pick]);
+            set_visited_bit(env, candidates_padded[pick]);
+            visited++;
+            current = candidates[pick];
+            continue;
+        }
+
+        // Hunt
+        while (visited_bit(env, cursor_padded)) {
+            cursor++;
+            cursor_padded++;
+            if (++cursor_col == maze->cols) {
+                cursor_col = 0;
+                cursor_padded += 2;
+            }
+        }
+        maze_neighbors(maze, cursor, &neighbors);
+        size_t adjacent = 0;
+        for (size_t i = 0; i < neighbors.count; i++) {
+            if (visited_bit(env, neighbors.padded[i])) candidates[adjacent++] = neighbors.cells[i];
+        }
+        assert(adjacent > 0);
+        remove_wall(maze, cursor, candidates[rng_below(&env->rng, adjacent)]);
+        set_visited_bit(env, cursor_padded);
+        visited++;
+        current = cursor;
+    }
+}
+
+static size_t kruskal_find(size_t* parent, size_t ind) {
+    while (parent[ind] != ind) {
+        parent[ind] = parent[parent[ind]];
+        ind = parent[ind];
+    }
+    return ind;
+}
+
+// Kruskal: visits every wall in random order and removes it whenever the two
+// cells are not connected yet
+void gen_maze_kruskal(Env* env) {
+    Maze* maze = &env->maze;
+    size_t total = maze->rows * maze->cols;
+    // A wall is encoded as `cell * 2 + is_south`
+    size_t wall_count = maze->rows * (maze->cols - 1) + (maze->rows - 1) * maze->cols;
+    size_t* walls = (size_t*)alloc_or_die(wall_count > 0 ? wall_count : 1, sizeof(size_t), "the Kruskal walls");
+    size_t* parent = (size_t*)alloc_or_die(total, sizeof(size_t), "the Kruskal sets");
+
+    size_t n = 0;
+    for (size_t r = 0; r < maze->rows; r++) {
+        for (size_t c = 0; c < maze->cols; c++) {
+            size_t ind = to_ind(maze, r, c);
+            parent[ind] = ind;
+            if (c + 1 < maze->cols) walls[n++] = ind * 2;
+            if (r + 1 < maze->rows) walls[n++] = ind * 2 + 1;
+        }
+    }
+    assert(n == wall_count);
+    // Fisher-Yates shuffle
+    for (size_t i = wall_count; i > 1; i--) {
+        size_t j = rng_below(&env->rng, i);
+        size_t temp = walls[i - 1];
+        walls[i - 1] = walls[j];
+        walls[j] = temp;
+    }
+
+    size_t removed = 0;
+    for (size_t i = 0; i < wall_count && removed + 1 < total; i++) {
+        size_t start = walls[i] / 2;
+        bool south = walls[i] % 2;
+        size_t target = south ? start + maze->cols : start + 1;
+        size_t a = kruskal_find(parent, start);
+        size_t b = kruskal_find(parent, target);
+        if (a == b) continue;
+        parent[b] = a;
+        maze_open(maze, start, south ? CELL_SOUTH_OPEN : CELL_EAST_OPEN);
+        removed++;
+    }
+
+    free(parent);
+    free(walls);
+}
+
+// Prim: grows the maze from a random cell by connecting a random frontier
+// cell to the visited region each step
+void gen_maze_prim(Env* env) {
+    Maze* maze = &env->maze;
+    size_t total = maze->rows * maze->cols;
+    uint8_t* in_frontier = (uint8_t*)alloc_or_die((total + 7) / 8, sizeof(uint8_t), "the Prim frontier");
+    // The stack doubles as the frontier list; cells are removed by swapping
+    // the last one into their slot
+    CellStack* frontier = &env->stack;
+    Neighbors neighbors;
+    size_t candidates[4];
+
+    size_t current = rng_below(&env->rng, total);
+    maze_neighbors(maze, current, &neighbors);
+    for (;;) {
+        set_visited_bit(env, neighbors.self_padded);
+        for (size_t i = 0; i < neighbors.count; i++) {
+            size_t ind = neighbors.cells[i];
+            if (visited_bit(env, neighbors.padded[i]) || ((in_frontier[ind / 8] >> (ind % 8)) & 1)) continue;
+            in_frontier[ind / 8] |= 1 << (ind % 8);
+            cell_stack_push(frontier, ind);
+        }
+        if (frontier->count == 0) break;
+
+        size_t pick = rng_below(&env->rng, frontier->count);
+        current = frontier->items[pick];
+        frontier->items[pick] = frontier->items[frontier->count - 1];
+        frontier->count--;
+
+        maze_neighbors(maze, current, &neighbors);
+        size_t adjacent = 0;
+        for (size_t i = 0; i < neighbors.count; i++) {
+            if (visited_bit(env, neighbors.padded[i])) candidates[adjacent++] = neighbors.cells[i];
+        }
+        assert(adjacent > 0);
+        remove_wall(maze, current, candidates[rng_below(&env->rng, adjacent)]);
+    }
+
+    free(in_frontier);
+}
+
+// Wilson: loop-erased random walks from every cell until they hit the maze,
+// which samples uniformly among all possible spanning trees
+void gen_maze_wilson(Env* env) {
+    Maze* maze = &env->maze;
+    size_t total = maze->rows * maze->cols;
+    // Slot in `Neighbors` order the walk last left each cell through
+    uint8_t* exits = (uint8_t*)alloc_or_die(total, sizeof(uint8_t), "the Wilson walk");
+    Neighbors neighbors;
+
+    mark_visited(env, rng_below(&env->rng, total));
+    for (size_t start = 0; start < total; start++) {
+        if (is_visited(env, start)) continue;
+        // Walk until the maze is hit; overwriting the exits erases the loops
+        size_t current = start;
+        for (;;) {
+            maze_neighbors(maze, current, &neighbors);
+            uint8_t exit = (uint8_t)rng_below(&env->rng, neighbors.count);
+            exits[current] = exit;
+            current = neighbors.cells[exit];
+            if (visited_bit(env, neighbors.padded[exit])) break;
+        }
+        // Carve the loop-erased path into the maze
+        current = start;
+        for (;;) {
+            maze_neighbors(maze, current, &neighbors);
+            set_visited_bit(env, neighbors.self_padded);
+            uint8_t exit = exits[current];
+            remove_wall(maze, current, neighbors.cells[exit]);
+            current = neighbors.cells[exit];
+            if (visited_bit(env, neighbors.padded[exit])) break;
+        }
+    }
+
+    free(exits);
+}
+
+typedef struct {
+    Maze* maze;
+    MazeAlgorithm algo;
+    size_t tile_size;
+    size_t tile_rows;
+    size_t tile_cols;
+    uint64_t seed;
+    // Index of the next tile nobody has claimed yet
+    size_t next_tile;
+} TileJob;
+
+// ORs the wall bits of `tile` into `maze` at (r0, c0). Only the first and
+// last byte of each row can be shared with a neighboring tile, so those are
+// the only ones that need an atomic update.
+static void maze_merge_tile(Maze* maze, const Maze* tile, size_t r0, size_t c0) {
+    for (size_t r = 0; r < tile->rows; r++) {
+        size_t base = to_ind(maze, r0 + r, c0);
+        size_t first_byte = base / CELLS_PER_BYTE;
+        size_t last_byte = (base + tile->cols - 1) / CELLS_PER_BYTE;
+        size_t byte = first_byte;
+        uint8_t acc = 0;
+        for (size_t c = 0; c <= tile->cols; c++) {
+            size_t ind = base + c;
+            if (c == tile->cols || ind / CELLS_PER_BYTE != byte) {
+                if (byte == first_byte || byte == last_byte) {
+                    __atomic_fetch_or(&maze->cells[byte], acc, __ATOMIC_RELAXED);
+                } else {
+                    maze->cells[byte] |= acc;
+                }
+                if (c == tile->cols) break;
+                byte = ind / CELLS_PER_BYTE;
+                acc = 0;
+            }
+            acc |= maze_cell(tile, to_ind(tile, r, c)) << ((ind % CELLS_PER_BYTE) * CELL_BITS);
+        }
+    }
+}
+
+static void* tile_worker(void* arg) {
+    TileJob* job = (TileJob*)arg;
+    size_t tile_count = job->tile_rows * job->tile_cols;
+    for (;;) {
+        size_t tile = __atomic_fetch_add(&job->next_tile, 1, __ATOMIC_RELAXED);
+        if (tile >= tile_count) break;
+        size_t r0 = (tile / job->tile_cols) * job->tile_size;
+        size_t c0 = (tile % job->tile_cols) * job->tile_size;
+        size_t rows = job->maze->rows - r0 < job->tile_size ? job->maze->rows - r0 : job->tile_size;
+        size_t cols = job->maze->cols - c0 < job->tile_size ? job->maze->cols - c0 : job->tile_size;
+
+        Env env = env_init(rows, cols, 0);
+        env.rng = rng_stream(job->seed, tile);
+        gen_maze(&env, job->algo);
+        env_deinit(&env);
+        maze_merge_tile(job->maze, &env.maze, r0, c0);
+        maze_deinit(&env.maze);
+    }
+    return NULL;
+}
+
+void run_workers(void* (*fn)(void*), void* job, size_t threads) {
+    if (threads <= 1) {
+        fn(job);
+        return;
+    }
+    // The calling thread works too, so only `threads - 1` extra are spawned
+    pthread_t* workers = (pthread_t*)alloc_or_die(threads - 1, sizeof(pthread_t), "the worker threads");
+    for (size_t i = 0; i < threads - 1; i++) {
+        if (pthread_create(&workers[i], NULL, fn, job) != 0) {
+            fprintf(stderr, "ERROR: Failed to start a worker thread\n");
+            exit(71); // UNIX sysexit.h error code 71
+        }
+    }
+    fn(job);
+    for (size_t i = 0; i < threads - 1; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+}
+
+void gen_maze_tiled(Maze* maze, MazeAlgorithm algo, size_t threads, size_t tile_size, uint64_t seed) {
+    assert(threads > 0 && tile_size > 0);
+    TileJob job = {
+        .maze = maze,
+        .algo = algo,
+        .tile_size = tile_size,
+        .tile_rows = (maze->rows + tile_size - 1) / tile_size,
+        .tile_cols = (maze->cols + tile_size - 1) / tile_size,
+        .seed = seed,
+        .next_tile = 0,
+    };
+    size_t tile_count = job.tile_rows * job.tile_cols;
+    if (threads > tile_count) threads = tile_count;
+
+    run_workers(tile_worker, &job, threads);
+
+    // Every tile is a spanning tree of its own cells, so connecting the tiles
+    // along a spanning tree of the tile grid gives a spanning tree overall
+    Env tiles = env_init(job.tile_rows, job.tile_cols, 0);
+    tiles.rng = rng_stream(seed, tile_count);
+    gen_maze_kruskal(&tiles);
+    // Walls of the tile grid are not walls of the maze; the seams opened
+    // below are counted instead
+    INSTR_ADD(walls_removed, -(uint64_t)(tile_count - 1));
+    env_deinit(&tiles);
+    for (size_t tr = 0; tr < job.tile_rows; tr++) {
+        for (size_t tc = 0; tc < job.tile_cols; tc++) {
+            uint8_t seams = maze_cell(&tiles.maze, to_ind(&tiles.maze, tr, tc));
+            size_t r0 = tr * tile_size;
+            size_t c0 = tc * tile_size;
+            size_t rows = maze->rows - r0 < tile_size ? maze->rows - r0 : tile_size;
+            size_t cols = maze->cols - c0 < tile_size ? maze->cols - c0 : tile_size;
+            if (seams & CELL_EAST_OPEN) {
+                maze_open(maze, to_ind(maze, r0 + rng_below(&tiles.rng, rows), c0 + cols - 1), CELL_EAST_OPEN);
+            }
+            if (seams & CELL_SOUTH_OPEN) {
+                maze_open(maze, to_ind(maze, r0 + rows - 1, c0 + rng_below(&tiles.rng, cols)), CELL_SOUTH_OPEN);
+            }
+        }
+    }
+    maze_deinit(&tiles.maze);
+}
+#endif // MAZE_H_IMPLEMENTATION
@@ -0,0 +1,464 @@
+// Entropy coding of perfect mazes, for archiving them in close to the
+// minimum number of bits
+//
+// A perfect maze is a spanning tree of the grid, so its two wall bits per
+// cell carry much less than two bits of information. The cells are coded in
+// row order with an adaptive binary range coder (the one LZMA uses). Each
+// wall is predicted from the walls around it that are already known, and
+// walls the tree structure decides are not coded at all: an east wall
+// between two cells that are already connected has to stay closed, and a
+// cell that is closed to the west, north and east has to open south.
+//
+// The grid is coded in independent square tiles, so a region is decoded by
+// decoding only the tiles it touches. Encoded data is one self-contained
+// block of bytes, little-endian:
+//       0  magic "MZST"
+//       4  u32 tile size
+//       8  u64 rows
+//      16  u64 columns
+//      24  u64 offset of every tile's code from the start of the block, in
+//          row order, plus one past the end of the last
+//
+// Define MAZE_CODEC_H_IMPLEMENTATION in exactly one file before including
+// this header to get the function definitions. The maze functions it uses
+// come from maze.h, which has to be included with its implementation too.
+#ifndef MAZE_CODEC_H_
+#define MAZE_CODEC_H_
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "maze.h"
+
+// Side of the tiles when nothing else is asked for, in cells. The model
+// starts over in every tile, so smaller tiles cost a little compression.
+#define MAZE_CODEC_TILE_SIZE 256
+#define MAZE_CODEC_HEADER_SIZE 24
+
+typedef struct {
+    uint8_t* bytes;
+    size_t length;
+} EncodedMaze;
+
+EncodedMaze maze_encode(const Maze* maze, size_t tile_size);
+void encoded_maze_deinit(EncodedMaze* encoded);
+// Reads the size from the header alone
+void maze_decode_size(const uint8_t* bytes, size_t length, size_t* rows, size_t* cols);
+Maze maze_decode(const uint8_t* bytes, size_t length);
+// Decodes the `rows` x `cols` cells starting at cell (`row`, `col`) into a
+// maze of that size. Cells keep the walls they open towards cells outside
+// the region, so the outer border of the result may have gaps.
+Maze maze_decode_region(const uint8_t* bytes, size_t length, size_t row, size_t col, size_t rows, size_t cols);
+
+#endif // MAZE_CODEC_H_
+
+#if defined(MAZE_CODEC_H_IMPLEMENTATION) && !defined(MAZE_CODEC_H_IMPLEMENTED)
+#define MAZE_CODEC_H_IMPLEMENTED
+static const uint8_t maze_codec_magic[4] = { 'M', 'Z', 'S', 'T' };
+
+// Probabilities are 11-bit fixed point and move 1/32 of the way towards
+// every coded bit
+#define RC_PROB_BITS 11
+#define RC_PROB_INIT (1 << (RC_PROB_BITS - 1))
+#define RC_MOVE_BITS 5
+#define RC_TOP (1u << 24)
+
+typedef struct {
+    uint64_t low;
+    uint32_t range;
+    uint8_t cache;
+    uint64_t cache_size;
+    ByteStack* out;
+} RangeEncoder;
+
+typedef struct {
+    uint32_t range;
+    uint32_t code;
+    const uint8_t* next;
+    const uint8_t* end;
+} RangeDecoder;
+
+static RangeEncoder range_encoder_init(ByteStack* out) {
+    return (RangeEncoder) { .low = 0, .range = 0xFFFFFFFFu, .cache = 0, .cache_size = 1, .out = out };
+}
+
+// Holds back bytes that a carry could still change
+static void range_encoder_shift(RangeEncoder* rc) {
+    if ((uint32_t)rc->low < 0xFF000000u || (rc->low >> 32) != 0) {
+        uint8_t carry = (uint8_t)(rc->low >> 32);
+        uint8_t byte = rc->cache;
+        do {
+            byte_stack_push(rc->out, (uint8_t)(byte + carry));
+            byte = 0xFF;
+        } while (--rc->cache_size != 0);
+        rc->cache = (uint8_t)(rc->low >> 24);
+    }
+    rc->cache_size++;
+    rc->low = (rc->low & 0x00FFFFFFu) << 8;
+}
+
+static inline void range_encode_bit(RangeEncoder* rc, uint16_t* prob, unsigned bit) {
+    uint32_t bound = (rc->range >> RC_PROB_BITS) * *prob;
+    if (bit == 0) {
+        rc->range = bound;
+        *prob += ((1 << RC_PROB_BITS) - *prob) >> RC_MOVE_BITS;
+    } else {
+        rc->low += bound;
+        rc->range -= bound;
+        *prob -= *prob >> RC_MOVE_BITS;
+    }
+    while (rc->range < RC_TOP) {
+        rc->range <<= 8;
+        range_encoder_shift(rc);
+    }
+}
+
+static void range_encoder_finish(RangeEncoder* rc) {
+    for (int i = 0; i < 5; i++) range_encoder_shift(rc);
+}
+
+// Past the end of the data the decoder reads zeros, so damaged input gives
+// a wrong maze instead of a crash
+static inline uint8_t range_decoder_byte(RangeDecoder* rc) {
+    return rc->next < rc->end ? *rc->next++ : 0;
+}
+
+static RangeDecoder range_decoder_init(const uint8_t* bytes, const uint8_t* end) {
+    RangeDecoder rc = { .range = 0xFFFFFFFFu, .code = 0, .next = bytes, .end = end };
+    for (int i = 0; i < 5; i++) rc.code = (rc.code << 8) | range_decoder_byte(&rc);
+    return rc;
+}
+
+static inline unsigned range_decode_bit(RangeDecoder* rc, uint16_t* prob) {
+    uint32_t bound = (rc->range >> RC_PROB_BITS) * *prob;
+    unsigned bit;
+    if (rc->code < bound) {
+        rc->range = bound;
+        *prob += ((1 << RC_PROB_BITS) - *prob) >> RC_MOVE_BITS;
+        bit = 0;
+    } else {
+        rc->code -= bound;
+        rc->range -= bound;
+        *prob -= *prob >> RC_MOVE_BITS;
+        bit = 1;
+    }
+    if (rc->range < RC_TOP) {
+        rc->range <<= 8;
+        rc->code = (rc->code << 8) | range_decoder_byte(rc);
+    }
+    return bit;
+}
+
+// Everything one tile is coded with. The arrays are sized for a full tile
+// and reused from tile to tile.
+typedef struct {
+    size_t width;
+    size_t height;
+    // Whether the tile touches the east/south/west/north edge of the maze
+    bool last_col;
+    bool last_row;
+    bool first_col;
+    bool first_row;
+    uint8_t* walls;
+    // Union-find over the cells of the tile, joined along every open wall
+    // coded so far. The rest is only kept up to date for the roots: cells of
+    // the current row in the set that are still to come, the last row (plus
+    // one) with a cell that opens south, and whether the set may leave the
+    // tile some other way.
+    uint32_t* parent;
+    uint32_t* pending;
+    uint32_t* south_row;
+    uint8_t* escapes;
+    uint16_t east[32];
+    uint16_t south[64];
+} TileCoder;
+
+static inline uint32_t tile_find(uint32_t* parent, uint32_t i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+static inline uint32_t tile_union(TileCoder* tile, uint32_t a, uint32_t b) {
+    a = tile_find(tile->parent, a);
+    b = tile_find(tile->parent, b);
+    tile->parent[a] = b;
+    tile->pending[b] += tile->pending[a];
+    if (tile->south_row[a] > tile->south_row[b]) tile->south_row[b] = tile->south_row[a];
+    tile->escapes[b] |= tile->escapes[a];
+    return b;
+}
+
+// Encodes `tile->walls` or decodes into them. Encoder and decoder run the
+// same model, so the one loop serves both; always inlining it gives each a
+// copy without the other's branches.
+//
+// Besides the neighboring walls the model tracks the sets of connected
+// cells the way Eller's algorithm does: a set has to leave a row through a
+// south wall, unless it can still leave the tile another way.
+static inline __attribute__((always_inline))
+void code_tile(TileCoder* tile, RangeEncoder* enc, RangeDecoder* dec, bool decoding) {
+    size_t w = tile->width;
+    size_t h = tile->height;
+    uint8_t* walls = tile->walls;
+    uint32_t* parent = tile->parent;
+    for (uint32_t i = 0; i < w * h; i++) {
+        parent[i] = i;
+        tile->pending[i] = 0;
+        tile->south_row[i] = 0;
+        tile->escapes[i] = 0;
+    }
+    for (size_t i = 0; i < 32; i++) tile->east[i] = RC_PROB_INIT;
+    for (size_t i = 0; i < 64; i++) tile->south[i] = RC_PROB_INIT;
+
+    for (size_t y = 0; y < h; y++) {
+        uint32_t row_start = (uint32_t)(y * w);
+        for (uint32_t i = row_start; i < row_start + w; i++) tile->pending[tile_find(parent, i)]++;
+        // Cells on the north and west edge may connect to cells outside the tile
+        if (y == 0 && !tile->first_row) {
+            for (uint32_t i = 0; i < w; i++) tile->escapes[i] = 1;
+        }
+        if (!tile->first_col) tile->escapes[tile_find(parent, row_start)] = 1;
+
+        for (size_t x = 0; x < w; x++) {
+            uint32_t i = row_start + (uint32_t)x;
+            // Walls of the cells to the west and north; the ones outside
+            // the tile count as closed
+            unsigned west_east = x > 0 ? walls[i - 1] & CELL_EAST_OPEN : 0;
+            unsigned west_south = x > 0 ? (walls[i - 1] & CELL_SOUTH_OPEN) >> 1 : 0;
+            unsigned north_south = y > 0 ? (walls[i - w] & CELL_SOUTH_OPEN) >> 1 : 0;
+            unsigned north_east = y > 0 ? walls[i - w] & CELL_EAST_OPEN : 0;
+            unsigned north_east_south = y > 0 && x + 1 < w ? (walls[i - w + 1] & CELL_SOUTH_OPEN) >> 1 : 0;
+            unsigned cell = decoding ? 0 : walls[i];
+
+            uint32_t root = tile_find(parent, i);
+            tile->pending[root]--;
+            unsigned opened_south = tile->south_row[root] == y + 1;
+            // Nothing else in this row can take the set further
+            unsigned stuck = tile->pending[root] == 0 && !opened_south && !tile->escapes[root];
+
+            unsigned east = 0;
+            if (x + 1 == w && tile->last_col) {
+                east = 0;
+            } else if (x + 1 < w && root == tile_find(parent, i + 1)) {
+                east = 0;
+            } else {
+                uint16_t* prob = &tile->east[west_east | north_south << 1 | north_east << 2 |
+                                             north_east_south << 3 | stuck << 4];
+                if (decoding) {
+                    east = range_decode_bit(dec, prob);
+                } else {
+                    east = cell & CELL_EAST_OPEN;
+                    range_encode_bit(enc, prob, east);
+                }
+            }
+            if (east) {
+                if (x + 1 < w) {
+                    root = tile_union(tile, i + 1, i);
+                } else {
+                    tile->escapes[root] = 1;
+                }
+            }
+
+            unsigned south = 0;
+            unsigned last = tile->pending[root] == 0;
+            opened_south = tile->south_row[root] == y + 1;
+            if (y + 1 == h && tile->last_row) {
+                south = 0;
+            } else if (last && !opened_south && !tile->escapes[root]) {
+                south = 1;
+            } else {
+                uint16_t* prob = &tile->south[east | west_east << 1 | north_south << 2 | west_south << 3 |
+                                              last << 4 | opened_south << 5];
+                if (decoding) {
+                    south = range_decode_bit(dec, prob);
+                } else {
+                    south = (cell & CELL_SOUTH_OPEN) >> 1;
+                    range_encode_bit(enc, prob, south);
+                }
+            }
+            if (south) {
+                tile->south_row[root] = (uint32_t)y + 1;
+                if (y + 1 < h) tile_union(tile, i + (uint32_t)w, i);
+            }
+            if (decoding) walls[i] = (uint8_t)(east | south << 1);
+        }
+    }
+}
+
+static void encode_tile(TileCoder* tile, RangeEncoder* enc) {
+    code_tile(tile, enc, NULL, false);
+}
+
+static void decode_tile(TileCoder* tile, RangeDecoder* dec) {
+    code_tile(tile, NULL, dec, true);
+}
+
+static void put_u32le(uint8_t* dst, uint32_t value) {
+    for (int i = 0; i < 4; i++) dst[i] = (uint8_t)(value >> 8*i);
+}
+
+static void put_u64le(uint8_t* dst, uint64_t value) {
+    for (int i = 0; i < 8; i++) dst[i] = (uint8_t)(value >> 8*i);
+}
+
+static uint64_t get_uint_le(const uint8_t* src, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) value |= (uint64_t)src[i] << 8*i;
+    return value;
+}
+
+static TileCoder tile_coder_init(size_t tile_size) {
+    TileCoder tile = {0};
+    tile.walls = (uint8_t*)alloc_or_die(tile_size * tile_size, sizeof(uint8_t), "the tile walls");
+    tile.parent = (uint32_t*)alloc_or_die(tile_size * tile_size, sizeof(uint32_t), "the tile sets");
+    tile.pending = (uint32_t*)alloc_or_die(tile_size * tile_size, sizeof(uint32_t), "the tile sets");
+    tile.south_row = (uint32_t*)alloc_or_die(tile_size * tile_size, sizeof(uint32_t), "the tile sets");
+    tile.escapes = (uint8_t*)alloc_or_die(tile_size * tile_size, sizeof(uint8_t), "the tile sets");
+    return tile;
+}
+
+static void tile_coder_deinit(TileCoder* tile) {
+    free(tile->walls);
+    free(tile->parent);
+    free(tile->pending);
+    free(tile->south_row);
+    free(tile->escapes);
+}
+
+// Places `tile` at tile row `tr`, tile column `tc` of a rows x cols maze
+static void tile_coder_place(TileCoder* tile, size_t tile_size, size_t rows, size_t cols, size_t tr, size_t tc) {
+    size_t row = tr * tile_size;
+    size_t col = tc * tile_size;
+    tile->height = rows - row < tile_size ? rows - row : tile_size;
+    tile->width = cols - col < tile_size ? cols - col : tile_size;
+    tile->first_row = row == 0;
+    tile->first_col = col == 0;
+    tile->last_row = row + tile->height == rows;
+    tile->last_col = col + tile->width == cols;
+}
+
+EncodedMaze maze_encode(const Maze* maze, size_t tile_size) {
+    // Cell indices inside a tile are 32 bits
+    assert(tile_size > 0 && tile_size <= 0xFFFF);
+    size_t tiles_down = (maze->rows + tile_size - 1) / tile_size;
+    size_t tiles_across = (maze->cols + tile_size - 1) / tile_size;
+    size_t tiles = tiles_down * tiles_across;
+    size_t table = MAZE_CODEC_HEADER_SIZE + (tiles + 1) * sizeof(uint64_t);
+
+    ByteStack out = byte_stack_init();
+    // Roughly what a maze needs, so the stack rarely has to grow
+    byte_stack_reserve(&out, table + maze->rows * maze->cols / 5 + 64);
+    for (size_t i = 0; i < table; i++) byte_stack_push(&out, 0);
+    memcpy(out.items, maze_codec_magic, sizeof(maze_codec_magic));
+    put_u32le(out.items + 4, (uint32_t)tile_size);
+    put_u64le(out.items + 8, maze->rows);
+    put_u64le(out.items + 16, maze->cols);
+
+    TileCoder tile = tile_coder_init(tile_size);
+    for (size_t tr = 0; tr < tiles_down; tr++) {
+        for (size_t tc = 0; tc < tiles_across; tc++) {
+            put_u64le(out.items + MAZE_CODEC_HEADER_SIZE + (tr * tiles_across + tc) * sizeof(uint64_t), out.count);
+            tile_coder_place(&tile, tile_size, maze->rows, maze->cols, tr, tc);
+            for (size_t y = 0; y < tile.height; y++) {
+                size_t ind = to_ind(maze, tr * tile_size + y, tc * tile_size);
+                for (size_t x = 0; x < tile.width; x++) tile.walls[y * tile.width + x] = maze_cell(maze, ind + x);
+            }
+            RangeEncoder enc = range_encoder_init(&out);
+            encode_tile(&tile, &enc);
+            range_encoder_finish(&enc);
+        }
+    }
+    put_u64le(out.items + MAZE_CODEC_HEADER_SIZE + tiles * sizeof(uint64_t), out.count);
+    tile_coder_deinit(&tile);
+    return (EncodedMaze) { .bytes = out.items, .length = out.count };
+}
+
+void encoded_maze_deinit(EncodedMaze* encoded) {
+    free(encoded->bytes);
+    *encoded = (EncodedMaze) {0};
+}
+
+static void maze_codec_invalid(const char* reason) {
+    fprintf(stderr, "ERROR: Invalid encoded maze: %s\n", reason);
+    exit(65); // UNIX sysexit.h error code 65
+}
+
+// Checks the header and that the offset table fits, and returns the tile
+// size. The offsets themselves are checked as tiles are decoded, so a small
+// region of a large maze does not pay for reading all of them.
+static size_t maze_codec_parse(const uint8_t* bytes, size_t length, size_t* rows, size_t* cols) {
+    if (length < MAZE_CODEC_HEADER_SIZE) maze_codec_invalid("truncated header");
+    if (memcmp(bytes, maze_codec_magic, sizeof(maze_codec_magic)) != 0) maze_codec_invalid("wrong magic number");
+    uint64_t tile_size = get_uint_le(bytes + 4, 4);
+    uint64_t r = get_uint_le(bytes + 8, 8);
+    uint64_t c = get_uint_le(bytes + 16, 8);
+    if (tile_size == 0 || tile_size > 0xFFFF || r == 0 || c == 0 || r > LONG_MAX || c > LONG_MAX ||
+        r > SIZE_MAX / c) {
+        maze_codec_invalid("bad dimensions");
+    }
+    uint64_t tiles = ((r + tile_size - 1) / tile_size) * ((c + tile_size - 1) / tile_size);
+    if (tiles + 1 > (length - MAZE_CODEC_HEADER_SIZE) / sizeof(uint64_t)) maze_codec_invalid("truncated tile table");
+    *rows = (size_t)r;
+    *cols = (size_t)c;
+    return (size_t)tile_size;
+}
+
+void maze_decode_size(const uint8_t* bytes, size_t length, size_t* rows, size_t* cols) {
+    maze_codec_parse(bytes, length, rows, cols);
+}
+
+Maze maze_decode_region(const uint8_t* bytes, size_t length, size_t row, size_t col, size_t rows, size_t cols) {
+    size_t maze_rows, maze_cols;
+    size_t tile_size = maze_codec_parse(bytes, length, &maze_rows, &maze_cols);
+    if (rows == 0 || cols == 0 || row >= maze_rows || col >= maze_cols ||
+        rows > maze_rows - row || cols > maze_cols - col) {
+        fprintf(stderr, "ERROR: The region is not inside the %zux%zu maze\n", maze_cols, maze_rows);
+        exit(64); // UNIX sysexit.h error code 64
+    }
+    size_t tiles_across = (maze_cols + tile_size - 1) / tile_size;
+    size_t tiles = tiles_across * ((maze_rows + tile_size - 1) / tile_size);
+    size_t table = MAZE_CODEC_HEADER_SIZE + (tiles + 1) * sizeof(uint64_t);
+    Maze maze = maze_init(rows, cols);
+    TileCoder tile = tile_coder_init(tile_size);
+    for (size_t tr = row / tile_size; tr <= (row + rows - 1) / tile_size; tr++) {
+        for (size_t tc = col / tile_size; tc <= (col + cols - 1) / tile_size; tc++) {
+            size_t i = tr * tiles_across + tc;
+            const uint8_t* offsets = bytes + MAZE_CODEC_HEADER_SIZE + i * sizeof(uint64_t);
+            uint64_t start = get_uint_le(offsets, 8);
+            uint64_t end = get_uint_le(offsets + sizeof(uint64_t), 8);
+            if (start < table || start > end || end > length) maze_codec_invalid("bad tile offset");
+            RangeDecoder dec = range_decoder_init(bytes + start, bytes + end);
+            tile_coder_place(&tile, tile_size, maze_rows, maze_cols, tr, tc);
+            decode_tile(&tile, &dec);
+
+            // The part of the tile inside the region
+            size_t y0 = tr * tile_size < row ? row - tr * tile_size : 0;
+            size_t x0 = tc * tile_size < col ? col - tc * tile_size : 0;
+            size_t y1 = row + rows - tr * tile_size < tile.height ? row + rows - tr * tile_size : tile.height;
+            size_t x1 = col + cols - tc * tile_size < tile.width ? col + cols - tc * tile_size : tile.width;
+            for (size_t y = y0; y < y1; y++) {
+                size_t r = tr * tile_size + y - row;
+                for (size_t x = x0; x < x1; x++) {
+                    uint8_t walls = tile.walls[y * tile.width + x];
+                    if (walls != 0) maze_open(&maze, to_ind(&maze, r, tc * tile_size + x - col), walls);
+                }
+            }
+        }
+    }
+    tile_coder_deinit(&tile);
+    return maze;
+}
+
+Maze maze_decode(const uint8_t* bytes, size_t length) {
+    size_t rows, cols;
+    maze_codec_parse(bytes, length, &rows, &cols);
+    return maze_decode_region(bytes, length, 0, 0, rows, cols);
+}
+#endif // MAZE_CODEC_H_IMPLEMENTATION
@@ -0,0 +1,224 @@
+// Compact binary .maze files, so a maze is generated once and then rendered
+// or solved as often as needed
+//
+// Layout, every integer little-endian:
+//       0  magic "MAZE\r\n\x1A\n"
+//       8  u32 format version
+//      12  u32 CRC-32 of the header, with this field zeroed, and the cells
+//      16  u64 rows
+//      24  u64 columns
+//      32  u64 seed
+//      40  u64 tile size of gen_maze_tiled(), 0 for a maze made in one piece
+//      48  algorithm name, NUL padded to 32 bytes
+//      80  zeros up to MAZE_FILE_HEADER_SIZE
+//     128  the cells exactly as Maze.cells packs them
+//
+// The cells start at an aligned offset after the header, so a mapped file
+// is used as a Maze in place without copying anything.
+//
+// Define MAZE_FILE_H_IMPLEMENTATION in exactly one file before including
+// this header to get the function definitions. The maze functions it uses
+// come from maze.h, which has to be included with its implementation too.
+#ifndef MAZE_FILE_H_
+#define MAZE_FILE_H_
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "maze.h"
+
+#ifdef MAZE_FILE_H_IMPLEMENTATION
+    #define CRC32_H_IMPLEMENTATION
+#endif
+#include "crc32.h"
+
+#define MAZE_FILE_VERSION 1
+#define MAZE_FILE_HEADER_SIZE 128
+#define MAZE_FILE_ALGORITHM_SIZE 32
+
+// How a stored maze was made; with the size that is enough to generate it
+// again
+typedef struct {
+    MazeAlgorithm algo;
+    uint64_t seed;
+    size_t tile_size;
+} MazeFileInfo;
+
+// A .maze file mapped read-only. `maze.cells` points into the mapping, so
+// the maze must not be changed or given to maze_deinit().
+typedef struct {
+    Maze maze;
+    MazeFileInfo info;
+    void* mapping;
+    size_t length;
+} MappedMazeFile;
+
+void maze_file_save(const char* filename, const Maze* maze, const MazeFileInfo* info);
+// Reads the file into a newly allocated maze, checking its CRC
+Maze maze_file_load(const char* filename, MazeFileInfo* info);
+// Maps the file without reading the cells. With `verify` every page is read
+// once up front to check the CRC; without it only the header is checked.
+MappedMazeFile maze_file_map(const char* filename, bool verify);
+void maze_file_unmap(MappedMazeFile* file);
+
+#endif // MAZE_FILE_H_
+
+#if defined(MAZE_FILE_H_IMPLEMENTATION) && !defined(MAZE_FILE_H_IMPLEMENTED)
+#define MAZE_FILE_H_IMPLEMENTED
+static const uint8_t maze_file_magic[8] = { 'M', 'A', 'Z', 'E', '\r', '\n', 0x1A, '\n' };
+
+static void put_le32(uint8_t* dst, uint32_t value) {
+    for (int i = 0; i < 4; i++) dst[i] = (uint8_t)(value >> 8*i);
+}
+
+static void put_le64(uint8_t* dst, uint64_t value) {
+    for (int i = 0; i < 8; i++) dst[i] = (uint8_t)(value >> 8*i);
+}
+
+static uint32_t get_le32(const uint8_t* src) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) value |= (uint32_t)src[i] << 8*i;
+    return value;
+}
+
+static uint64_t get_le64(const uint8_t* src) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) value |= (uint64_t)src[i] << 8*i;
+    return value;
+}
+
+static size_t maze_file_cell_bytes(size_t rows, size_t cols) {
+    return (rows * cols + CELLS_PER_BYTE - 1) / CELLS_PER_BYTE;
+}
+
+static void maze_file_invalid(const char* filename, const char* reason) {
+    fprintf(stderr, "ERROR: '%s' is not a valid maze file: %s\n", filename, reason);
+    exit(65); // UNIX sysexit.h error code 65
+}
+
+// CRC of the header with its CRC field zeroed, followed by the cells
+static uint32_t maze_file_crc(const uint8_t* header, const uint8_t* cells, size_t cell_bytes) {
+    uint8_t copy[MAZE_FILE_HEADER_SIZE];
+    memcpy(copy, header, sizeof(copy));
+    put_le32(copy + 12, 0);
+    return crc32_update(crc32_update(0, copy, sizeof(copy)), cells, cell_bytes);
+}
+
+// Checks everything the header alone can tell and returns the size of the
+// cells that have to follow it
+static size_t maze_file_parse_header(const char* filename, const uint8_t* header, Maze* maze, MazeFileInfo* info) {
+    if (memcmp(header, maze_file_magic, sizeof(maze_file_magic)) != 0) {
+        maze_file_invalid(filename, "wrong magic number");
+    }
+    if (get_le32(header + 8) != MAZE_FILE_VERSION) maze_file_invalid(filename, "unsupported version");
+    uint64_t rows = get_le64(header + 16);
+    uint64_t cols = get_le64(header + 24);
+    // The same limit the command line puts on the size
+    if (rows == 0 || cols == 0 || rows > LONG_MAX || cols > LONG_MAX || rows > SIZE_MAX / cols) {
+        maze_file_invalid(filename, "bad dimensions");
+    }
+    char name[MAZE_FILE_ALGORITHM_SIZE + 1] = {0};
+    memcpy(name, header + 48, MAZE_FILE_ALGORITHM_SIZE);
+    if (!maze_algorithm_from_name(name, &info->algo)) maze_file_invalid(filename, "unknown algorithm");
+    info->seed = get_le64(header + 32);
+    info->tile_size = (size_t)get_le64(header + 40);
+    *maze = (Maze) { .rows = (size_t)rows, .cols = (size_t)cols };
+    return maze_file_cell_bytes(maze->rows, maze->cols);
+}
+
+void maze_file_save(const char* filename, const Maze* maze, const MazeFileInfo* info) {
+    uint8_t header[MAZE_FILE_HEADER_SIZE] = {0};
+    memcpy(header, maze_file_magic, sizeof(maze_file_magic));
+    put_le32(header + 8, MAZE_FILE_VERSION);
+    put_le64(header + 16, maze->rows);
+    put_le64(header + 24, maze->cols);
+    put_le64(header + 32, info->seed);
+    put_le64(header + 40, info->tile_size);
+    const char* name = maze_algorithm_name(info->algo);
+    assert(strlen(name) < MAZE_FILE_ALGORITHM_SIZE);
+    memcpy(header + 48, name, strlen(name));
+    size_t cell_bytes = maze_file_cell_bytes(maze->rows, maze->cols);
+    put_le32(header + 12, maze_file_crc(header, maze->cells, cell_bytes));
+
+    FILE* fp = fopen(filename, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "ERROR: Failed to open '%s' for writing\n", filename);
+        exit(72); // UNIX sysexit.h error code 72
+    }
+    if (fwrite(header, 1, sizeof(header), fp) != sizeof(header) ||
+        fwrite(maze->cells, 1, cell_bytes, fp) != cell_bytes || fclose(fp) != 0) {
+        fprintf(stderr, "ERROR: Failed to write '%s'\n", filename);
+        exit(74); // UNIX sysexit.h error code 74
+    }
+}
+
+Maze maze_file_load(const char* filename, MazeFileInfo* info) {
+    FILE* fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "ERROR: Failed to open '%s'\n", filename);
+        exit(66); // UNIX sysexit.h error code 66
+    }
+    uint8_t header[MAZE_FILE_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), fp) != sizeof(header)) maze_file_invalid(filename, "truncated header");
+    Maze shape = {0};
+    size_t cell_bytes = maze_file_parse_header(filename, header, &shape, info);
+    Maze maze = maze_init(shape.rows, shape.cols);
+    // One more byte than expected would mean trailing garbage
+    if (fread(maze.cells, 1, cell_bytes, fp) != cell_bytes || fgetc(fp) != EOF) {
+        maze_file_invalid(filename, "wrong size");
+    }
+    fclose(fp);
+    if (maze_file_crc(header, maze.cells, cell_bytes) != get_le32(header + 12)) {
+        maze_file_invalid(filename, "checksum mismatch");
+    }
+    return maze;
+}
+
+MappedMazeFile maze_file_map(const char* filename, bool verify) {
+    MappedMazeFile file = {0};
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: Failed to open '%s'\n", filename);
+        exit(66); // UNIX sysexit.h error code 66
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        fprintf(stderr, "ERROR: Failed to read '%s'\n", filename);
+        exit(74); // UNIX sysexit.h error code 74
+    }
+    if ((uint64_t)st.st_size < MAZE_FILE_HEADER_SIZE) maze_file_invalid(filename, "truncated header");
+    file.length = (size_t)st.st_size;
+    file.mapping = mmap(NULL, file.length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (file.mapping == MAP_FAILED) {
+        fprintf(stderr, "ERROR: Failed to map '%s'\n", filename);
+        exit(74); // UNIX sysexit.h error code 74
+    }
+    // The mapping keeps the file alive on its own
+    close(fd);
+
+    const uint8_t* header = (const uint8_t*)file.mapping;
+    size_t cell_bytes = maze_file_parse_header(filename, header, &file.maze, &file.info);
+    if (file.length - MAZE_FILE_HEADER_SIZE != cell_bytes) maze_file_invalid(filename, "wrong size");
+    file.maze.cells = (uint8_t*)file.mapping + MAZE_FILE_HEADER_SIZE;
+    if (verify) {
+        madvise(file.mapping, file.length, MADV_SEQUENTIAL);
+        if (maze_file_crc(header, file.maze.cells, cell_bytes) != get_le32(header + 12)) {
+            maze_file_invalid(filename, "checksum mismatch");
+        }
+    }
+    return file;
+}
+
+void maze_file_unmap(MappedMazeFile* file) {
+    munmap(file->mapping, file->length);
+    *file = (MappedMazeFile) {0};
+}
+#endif // MAZE_FILE_H_IMPLEMENTATION
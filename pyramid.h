@@ -0,0 +1,188 @@
+// Deep Zoom (DZI) tile pyramids, for mazes too large to view as one image
+//
+// `write_maze_pyramid(maze, "out/maze", ...)` writes the descriptor
+// out/maze.dzi and the tiles out/maze_files/<level>/<column>_<row>.<format>.
+// The highest level is the full image and every level below it half the size
+// of the one above, rounding up, down to a single pixel at level 0. Tiles do
+// not overlap; the last ones in a row or column are cut short.
+//
+// Every tile is drawn straight from the cells it covers: tiles of the full
+// image with render_window_indexed(), the smaller levels with
+// render_window_shaded(), so no level is ever made by shrinking another and
+// nothing larger than a tile is held in memory. Tiles are spread over
+// threads one at a time.
+//
+// Define PYRAMID_H_IMPLEMENTATION in exactly one file before including this
+// header to get the function definitions. It needs maze.h and render.h
+// included with their implementations too.
+#ifndef PYRAMID_H_
+#define PYRAMID_H_
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "maze.h"
+#include "render.h"
+
+// Side length of the tiles in pixels, what viewers usually expect
+#define PYRAMID_TILE_SIZE 256
+
+// Number of levels, including level 0
+size_t pyramid_levels(size_t width, size_t height);
+// Returns the number of tiles written
+size_t write_maze_pyramid(const Maze* maze, const char* name, size_t tile_size, ImageFormat format, size_t threads);
+
+#endif // PYRAMID_H_
+
+#if defined(PYRAMID_H_IMPLEMENTATION) && !defined(PYRAMID_H_IMPLEMENTED)
+#define PYRAMID_H_IMPLEMENTED
+size_t pyramid_levels(size_t width, size_t height) {
+    size_t longest = width > height ? width : height;
+    size_t levels = 1;
+    while (((size_t)1 << (levels - 1)) < longest) levels++;
+    return levels;
+}
+
+typedef struct {
+    // The full image is shrunk by this much
+    size_t scale;
+    size_t width;
+    size_t height;
+    size_t tiles_across;
+    // Index of the first tile of the level among all of them
+    size_t first_tile;
+} PyramidLevel;
+
+typedef struct {
+    const Maze* maze;
+    const char* files;
+    ImageFormat format;
+    size_t tile_size;
+    // Pixels of the largest tile, no more than the full image has
+    size_t tile_pixels;
+    PyramidLevel* levels;
+    size_t level_count;
+    size_t tile_count;
+    // First tile nobody has claimed yet
+    size_t next_tile;
+} PyramidJob;
+
+static void pyramid_mkdir(const char* path) {
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "ERROR: Failed to create directory '%s'\n", path);
+        exit(73); // UNIX sysexit.h error code 73
+    }
+}
+
+// Tiles are independent, so the workers only share the tile counter
+static void* pyramid_worker(void* arg) {
+    PyramidJob* job = (PyramidJob*)arg;
+    size_t tile_size = job->tile_size;
+    uint8_t* pixels = (uint8_t*)alloc_or_die(job->tile_pixels, sizeof(uint8_t), "the tile");
+    size_t path_size = strlen(job->files) + 96;
+    char* path = (char*)alloc_or_die(path_size, sizeof(char), "the tile path");
+    for (;;) {
+        size_t tile = __atomic_fetch_add(&job->next_tile, 1, __ATOMIC_RELAXED);
+        if (tile >= job->tile_count) break;
+        size_t l = job->level_count - 1;
+        while (job->levels[l].first_tile > tile) l--;
+        const PyramidLevel* level = &job->levels[l];
+        size_t tx = (tile - level->first_tile) % level->tiles_across;
+        size_t ty = (tile - level->first_tile) / level->tiles_across;
+        size_t x = tx * tile_size;
+        size_t y = ty * tile_size;
+        size_t width = level->width - x < tile_size ? level->width - x : tile_size;
+        size_t height = level->height - y < tile_size ? level->height - y : tile_size;
+
+        snprintf(path, path_size, "%s/%zu/%zu_%zu.%s", job->files, l, tx, ty, image_format_name(job->format));
+        ImageWriter writer = {0};
+        if (level->scale == 1) {
+            render_window_indexed(job->maze, pixels, x, y, width, height);
+            writer = image_writer_open(path, job->format, width, height);
+            image_writer_write_indexed(&writer, pixels, height);
+        } else {
+            render_window_shaded(job->maze, pixels, x, y, width, height, level->scale);
+            writer = image_writer_open_shaded(path, job->format, width, height);
+            image_writer_write_shaded(&writer, pixels, height);
+        }
+        image_writer_close(&writer);
+    }
+    free(path);
+    free(pixels);
+    return NULL;
+}
+
+size_t write_maze_pyramid(const Maze* maze, const char* name, size_t tile_size, ImageFormat format, size_t threads) {
+    assert(tile_size > 0);
+    size_t width = image_width(maze->cols);
+    size_t height = image_height(maze->rows);
+    size_t level_count = pyramid_levels(width, height);
+    PyramidLevel* levels = (PyramidLevel*)alloc_or_die(level_count, sizeof(PyramidLevel), "the pyramid levels");
+    size_t tile_count = 0;
+    for (size_t l = 0; l < level_count; l++) {
+        size_t scale = (size_t)1 << (level_count - 1 - l);
+        PyramidLevel* level = &levels[l];
+        level->scale = scale;
+        level->width = (width + scale - 1) / scale;
+        level->height = (height + scale - 1) / scale;
+        level->tiles_across = (level->width + tile_size - 1) / tile_size;
+        level->first_tile = tile_count;
+        tile_count += level->tiles_across * ((level->height + tile_size - 1) / tile_size);
+    }
+    // Checked before anything is written, so a tile too large to hold leaves
+    // no half-made pyramid behind
+    size_t tile_width = tile_size < width ? tile_size : width;
+    size_t tile_height = tile_size < height ? tile_size : height;
+    if (tile_width > SIZE_MAX / tile_height) {
+        fprintf(stderr, "ERROR: A %zux%zu tile is too large to address\n", tile_width, tile_height);
+        exit(71); // UNIX sysexit.h error code 71
+    }
+
+    size_t path_size = strlen(name) + 64;
+    char* path = (char*)alloc_or_die(path_size, sizeof(char), "the pyramid path");
+    snprintf(path, path_size, "%s.dzi", name);
+    FILE* fp = fopen(path, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "ERROR: Failed to open '%s' for writing\n", path);
+        exit(72); // UNIX sysexit.h error code 72
+    }
+    fprintf(fp, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf(fp, "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" Format=\"%s\" Overlap=\"0\" "
+                "TileSize=\"%zu\">\n", image_format_name(format), tile_size);
+    fprintf(fp, "  <Size Width=\"%zu\" Height=\"%zu\"/>\n", width, height);
+    fprintf(fp, "</Image>\n");
+    if (fclose(fp) != 0) {
+        fprintf(stderr, "ERROR: Failed to write '%s'\n", path);
+        exit(74); // UNIX sysexit.h error code 74
+    }
+
+    char* files = (char*)alloc_or_die(path_size, sizeof(char), "the pyramid path");
+    snprintf(files, path_size, "%s_files", name);
+    pyramid_mkdir(files);
+    for (size_t l = 0; l < level_count; l++) {
+        snprintf(path, path_size, "%s/%zu", files, l);
+        pyramid_mkdir(path);
+    }
+
+    PyramidJob job = {
+        .maze = maze,
+        .files = files,
+        .format = format,
+        .tile_size = tile_size,
+        .tile_pixels = tile_width * tile_height,
+        .levels = levels,
+        .level_count = level_count,
+        .tile_count = tile_count,
+        .next_tile = 0,
+    };
+    if (threads > tile_count) threads = tile_count;
+    run_workers(pyramid_worker, &job, threads);
+    free(files);
+    free(path);
+    free(levels);
+    return tile_count;
+}
+#endif // PYRAMID_H_IMPLEMENTATION
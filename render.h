@@ -0,0 +1,1487 @@
+// Rasterization of mazes into images and PPM/PGM/PBM/PNG output
+//
+// Define RENDER_H_IMPLEMENTATION in exactly one file before including this
+// header to get the function definitions. The maze functions it draws with
+// come from maze.h, which has to be included with its implementation too.
+#ifndef RENDER_H_
+#define RENDER_H_
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "maze.h"
+
+#ifdef RENDER_H_IMPLEMENTATION
+    #define CRC32_H_IMPLEMENTATION
+#endif
+#include "crc32.h"
+
+// Default look of a maze. Every one of these can be changed at runtime with
+// `render_set_style`; they only decide what is drawn when nothing else is asked for.
+#define DEFAULT_SOLID 0x32A852
+#if 1
+#define DEFAULT_OPEN 0x0 // BLACK Color
+#else
+#define DEFAULT_OPEN 0x2856A1 // BLUE Color
+#endif
+
+#define DEFAULT_OPEN_WIDTH 10
+#define DEFAULT_OPEN_HEIGHT 10
+#define DEFAULT_BORDER_THICKNESS 1
+
+// Sizes in pixels and 0xRRGGBB colors a maze is drawn with
+typedef struct {
+    size_t open_width;
+    size_t open_height;
+    size_t border;
+    uint32_t solid;
+    uint32_t open;
+} RenderStyle;
+
+#define DEFAULT_RENDER_STYLE ((RenderStyle) { DEFAULT_OPEN_WIDTH, DEFAULT_OPEN_HEIGHT, DEFAULT_BORDER_THICKNESS, \
+                                              DEFAULT_SOLID, DEFAULT_OPEN })
+
+// The style everything is drawn with. It also picks the row kernels, so it
+// is only changed through `render_set_style`, before any drawing starts.
+extern RenderStyle render_style;
+
+typedef struct {
+    uint32_t* pixels;
+    size_t width;
+    size_t height;
+} Image;
+
+#define img_at(img, x, y) (img)->pixels[(y) * (img)->width + (x)]
+
+// Pixel rows taken up by one row of cells together with its south wall
+#define CELL_ROW_HEIGHT (render_style.open_height + render_style.border)
+
+// Switches to `style` and selects the row kernels specialized for its sizes,
+// or the generic ones. Returns false, leaving the style as it was, if the
+// sizes are zero, a color is not 0xRRGGBB or both colors are the same.
+bool render_set_style(RenderStyle style);
+// Name of the row kernels the current style uses: "default", "8x1", ... or "generic"
+const char* render_kernel_name(void);
+
+size_t image_width(size_t cols);
+size_t image_height(size_t rows);
+Image image_init(size_t rows, size_t cols);
+void image_deinit(Image* img);
+
+void fill_rect(Image* img, size_t rx, size_t ry, size_t rw, size_t rh, uint32_t color);
+void init_maze(Image* img, const Maze* maze);
+// Same pixels as `init_maze`, but every row is written exactly once
+void render_maze(Image* img, const Maze* maze);
+// `render_maze` on `threads` threads, each drawing whole bands of cell rows
+void render_maze_threaded(Image* img, const Maze* maze, size_t threads);
+// Draws just the pixels in [x, x + width) x [y, y + height) of the image as
+// palette indices, `width` to a row, from the cells that intersect them
+void render_window_indexed(const Maze* maze, uint8_t* indices, size_t x, size_t y, size_t width, size_t height);
+// The same window of the image shrunk `scale` times, each pixel the shade of
+// the `scale` x `scale` pixels it covers (fewer at the right and bottom edge,
+// the shrunk size rounds up). Only the cells under the window are read, and
+// large blocks count walls in the cell bits instead of drawing them, so the
+// cost stays near one pass over those cells whatever the scale.
+void render_window_shaded(const Maze* maze, uint8_t* shades, size_t x, size_t y, size_t width, size_t height,
+                          size_t scale);
+// A rectangle of the full-size image in pixels
+typedef struct {
+    size_t x;
+    size_t y;
+    size_t width;
+    size_t height;
+} ImageRect;
+
+// The pixels showing cells [row, row + rows) x [col, col + cols) and the
+// walls around them
+ImageRect image_rect_of_cells(size_t row, size_t col, size_t rows, size_t cols);
+
+// Output formats. PPM is 24-bit color; PGM (8-bit gray), PBM (1 bit, walls
+// black) and PNG (1-bit indexed, with the real colors as its palette) only
+// need to tell the two colors apart, so they are written from palette
+// indices without ever going through RGB.
+typedef enum {
+    FORMAT_PPM,
+    FORMAT_PGM,
+    FORMAT_PBM,
+    FORMAT_PNG,
+    FORMAT_COUNT,
+} ImageFormat;
+
+// Palette indices of the two colors, one byte per pixel
+#define INDEX_OPEN 0
+#define INDEX_SOLID 1
+
+// Shaded pixels are one byte each: how much of the area a pixel stands for
+// is wall, from SHADE_OPEN (none) to SHADE_SOLID (all of it). They are drawn
+// as that blend of the two colors.
+#define SHADE_OPEN 0
+#define SHADE_SOLID 255
+
+const char* image_format_name(ImageFormat format);
+bool image_format_from_name(const char* name, ImageFormat* format);
+
+void save_image(const Image* img, const char* filename, ImageFormat format);
+void save_as_ppm(const Image* img, const char* filename);
+void render_cell_row(uint32_t* band, size_t width, const uint8_t* walls, size_t cols);
+// Same as `render_cell_row`, with INDEX_OPEN/INDEX_SOLID bytes as pixels
+void render_cell_row_indexed(uint8_t* band, size_t width, const uint8_t* walls, size_t cols);
+// The fallback kernels for sizes nothing is specialized for, whatever the
+// current style selected; exposed for benchmarks
+void render_cell_row_generic(uint32_t* band, size_t width, const uint8_t* walls, size_t cols);
+void render_cell_row_indexed_generic(uint8_t* band, size_t width, const uint8_t* walls, size_t cols);
+
+// Bytes of encoded rows the image writer collects before handing them to the OS
+#define IMAGE_WRITER_BUFFER_SIZE (1 << 20)
+
+// Writes an image one batch of pixel rows at a time, so the whole image
+// never has to be in memory. Rows are encoded into one large buffer that
+// goes out in a single write once it is full.
+typedef struct {
+    FILE* fp;
+    ImageFormat format;
+    size_t width;
+    // Encoded size of one row, including the PNG filter byte
+    size_t row_bytes;
+    uint8_t* bytes;
+    size_t length;
+    size_t capacity;
+    // One row of palette indices, when RGB pixels have to be converted
+    uint8_t* indices;
+    // Writes shades instead of the two colors, PNG with an 8-bit palette
+    bool shaded;
+    // 0xRRGGBB of every shade, when shaded
+    uint32_t* shade_colors;
+    // Adler-32 of the uncompressed PNG data so far
+    uint32_t adler_a;
+    uint32_t adler_b;
+    bool idat_started;
+} ImageWriter;
+
+ImageWriter image_writer_open(const char* filename, ImageFormat format, size_t width, size_t height);
+void image_writer_write(ImageWriter* writer, const uint32_t* pixels, size_t rows);
+void image_writer_write_indexed(ImageWriter* writer, const uint8_t* indices, size_t rows);
+// A writer for shaded pixels, given to `image_writer_write_shaded`
+ImageWriter image_writer_open_shaded(const char* filename, ImageFormat format, size_t width, size_t height);
+void image_writer_write_shaded(ImageWriter* writer, const uint8_t* shades, size_t rows);
+void image_writer_close(ImageWriter* writer);
+// Converts `count` 0xRRGGBB pixels to RGB24
+void pack_rgb24(uint8_t* dst, const uint32_t* src, size_t count);
+
+// Renders one band of cells at a time straight into the output file, so
+// memory use depends on the maze width alone instead of the image size
+void stream_maze_to_file(const Maze* maze, const char* filename, ImageFormat format);
+// Sizes the output file up front, maps it and lets `threads` threads encode
+// bands of rows straight into their place in it. Every PPM, PGM and PBM row
+// has a fixed offset after the header; PNG is not supported.
+void render_maze_to_mapped_file(const Maze* maze, const char* filename, ImageFormat format, size_t threads);
+// Writes just `crop` of the image, shrunk `scale` times with shaded pixels
+// as in `render_window_shaded` (blocks start at the corner of the crop), or
+// exactly with a scale of 1. Only the cells under the crop are read and
+// rows are written as they are done, so time and memory follow the size of
+// the crop, not of the maze.
+void render_crop_to_file(const Maze* maze, const char* filename, ImageFormat format, ImageRect crop, size_t scale);
+// Size of the thumbnail whose longer side is `size` pixels, or of the whole
+// image when that is not larger
+void thumbnail_size(const Maze* maze, size_t size, size_t* width, size_t* height);
+// Shades of the whole image shrunk to `width` x `height` pixels by any
+// factor, each pixel the share of wall in its part of the image (the parts
+// differ by at most a pixel on a side). Computed from the cell bits like
+// `render_window_shaded`, never from drawn pixels of the full image.
+void render_thumbnail(const Maze* maze, uint8_t* shades, size_t width, size_t height);
+// `render_thumbnail` of the given size straight into a file
+void render_thumbnail_to_file(const Maze* maze, const char* filename, ImageFormat format, size_t size);
+
+#endif // RENDER_H_
+
+#if defined(RENDER_H_IMPLEMENTATION) && !defined(RENDER_H_IMPLEMENTED)
+#define RENDER_H_IMPLEMENTED
+RenderStyle render_style = {
+    .open_width = DEFAULT_OPEN_WIDTH,
+    .open_height = DEFAULT_OPEN_HEIGHT,
+    .border = DEFAULT_BORDER_THICKNESS,
+    .solid = DEFAULT_SOLID,
+    .open = DEFAULT_OPEN,
+};
+
+size_t image_width(size_t cols) {
+    return (cols * render_style.open_width) + ((cols + 1) * render_style.border);
+}
+
+size_t image_height(size_t rows) {
+    return (rows * render_style.open_height) + ((rows + 1) * render_style.border);
+}
+
+ImageRect image_rect_of_cells(size_t row, size_t col, size_t rows, size_t cols) {
+    return (ImageRect) {
+        .x = col * (render_style.open_width + render_style.border),
+        .y = row * CELL_ROW_HEIGHT,
+        .width = image_width(cols),
+        .height = image_height(rows),
+    };
+}
+
+Image image_init(size_t rows, size_t cols) {
+    Image img = {0};
+    img.width = image_width(cols);
+    img.height = image_height(rows);
+    // Guard against `width * height * sizeof(uint32_t)` wrapping around
+    if (img.height != 0 && img.width > SIZE_MAX / sizeof(uint32_t) / img.height) {
+        fprintf(stderr, "ERROR: A %zux%zu image is too large to address\n", img.width, img.height);
+        exit(71); // UNIX sysexit.h error code 71
+    }
+    img.pixels = (uint32_t*)calloc(img.width * img.height, sizeof(uint32_t));
+    if (img.pixels == NULL) {
+        fprintf(stderr, "ERROR: Failed to allocate a %zux%zu image\n", img.width, img.height);
+        exit(71); // UNIX sysexit.h error code 71
+    }
+    return img;
+}
+
+void image_deinit(Image* img) {
+    free(img->pixels);
+    img->pixels = NULL;
+    img->width = 0;
+    img->height = 0;
+}
+
+void fill_rect(Image* img, size_t rx, size_t ry, size_t rw, size_t rh, uint32_t color) {
+    assert(rx + rw <= img->width);
+    assert(ry + rh <= img->height);
+    for (size_t y = ry; y < (ry + rh); y++) {
+        for (size_t x = rx; x < (rx + rw); x++) {
+            img_at(img, x, y) = color;
+        }
+    }
+}
+
+void init_maze(Image* img, const Maze* maze) {
+    size_t y, x;
+    size_t open_width = render_style.open_width;
+    size_t open_height = render_style.open_height;
+    size_t border = render_style.border;
+    // The image may be reused from a previous maze
+    fill_rect(img, 0, 0, img->width, img->height, render_style.open);
+    for (size_t r = 0; r < maze->rows; r++) {
+        for (size_t c = 0; c <= maze->cols; c++) {
+            y = (r * open_height) + (r * border);
+            x = (c * open_width) + (c * border);
+            fill_rect(img, x, y, border, open_height + (2*border), render_style.solid);
+        }
+    }
+
+    for (size_t r = 0; r <= maze->rows; r++) {
+        for (size_t c = 0; c < maze->cols; c++) {
+            y = (r * open_height) + (r * border);
+            x = (c * open_width) + (c * border);
+            fill_rect(img, x, y, open_width + (2*border), border, render_style.solid);
+        }
+    }
+
+    for (size_t r = 0; r < maze->rows; r++) {
+        for (size_t c = 0; c < maze->cols; c++) {
+            uint8_t cell = maze_cell(maze, to_ind(maze, r, c));
+            y = (r * open_height) + (r * border);
+            x = (c * open_width) + (c * border);
+            if (cell & CELL_EAST_OPEN) {
+                fill_rect(img, x + open_width + border, y + border, border, open_height, render_style.open);
+            }
+            if (cell & CELL_SOUTH_OPEN) {
+                fill_rect(img, x + border, y + open_height + border, open_width, border, render_style.open);
+            }
+        }
+    }
+}
+
+void save_image(const Image* img, const char* filename, ImageFormat format) {
+    ImageWriter writer = image_writer_open(filename, format, img->width, img->height);
+    image_writer_write(&writer, img->pixels, img->height);
+    image_writer_close(&writer);
+}
+
+void save_as_ppm(const Image* img, const char* filename) {
+    save_image(img, filename, FORMAT_PPM);
+}
+
+// Fills `count` pixels with one color: memset when all bytes of the color
+// are the same, otherwise a plain loop the compiler turns into wide stores
+static inline void fill_span(uint32_t* dst, size_t count, uint32_t color) {
+    if ((color & 0xFF) * 0x01010101u == color) {
+        memset(dst, color & 0xFF, count * sizeof(uint32_t));
+        return;
+    }
+    for (size_t i = 0; i < count; i++) dst[i] = color;
+}
+
+// Builds a pixel row out of runs: neighboring spans of the same color are
+// merged and only filled once the color changes
+typedef struct {
+    uint32_t* row;
+    size_t start;
+    size_t end;
+    uint32_t color;
+} SpanRow;
+
+static inline void span_push(SpanRow* span, uint32_t color, size_t count) {
+    if (color != span->color) {
+        fill_span(span->row + span->start, span->end - span->start, span->color);
+        span->start = span->end;
+        span->color = color;
+    }
+    span->end += count;
+}
+
+static inline void span_flush(SpanRow* span) {
+    fill_span(span->row + span->start, span->end - span->start, span->color);
+}
+
+// Draws one row of cells, given one wall byte (CELL_EAST_OPEN | CELL_SOUTH_OPEN)
+// per cell, into `CELL_ROW_HEIGHT` rows of `width` pixels: the open interior
+// of the cells followed by their south wall. The first row of each kind is
+// built from runs and the others are copies of it.
+//
+// The widths are arguments so that the specialized kernels below get them
+// as constants; always inlining keeps them constant all the way down.
+static inline __attribute__((always_inline))
+void cell_row_kernel(uint32_t* band, size_t width, const uint8_t* walls, size_t cols,
+                     size_t open_width, size_t border) {
+    assert(width == image_width(cols));
+    uint32_t solid = render_style.solid;
+    uint32_t open = render_style.open;
+    SpanRow inner = { .row = band, .color = solid };
+    span_push(&inner, solid, border);
+    for (size_t c = 0; c < cols; c++) {
+        span_push(&inner, open, open_width);
+        span_push(&inner, (walls[c] & CELL_EAST_OPEN) ? open : solid, border);
+    }
+    span_flush(&inner);
+    for (size_t y = 1; y < render_style.open_height; y++) {
+        memcpy(band + y * width, band, width * sizeof(uint32_t));
+    }
+
+    uint32_t* south_row = band + render_style.open_height * width;
+    SpanRow south = { .row = south_row, .color = solid };
+    span_push(&south, solid, border);
+    for (size_t c = 0; c < cols; c++) {
+        span_push(&south, (walls[c] & CELL_SOUTH_OPEN) ? open : solid, open_width);
+        span_push(&south, solid, border);
+    }
+    span_flush(&south);
+    for (size_t y = 1; y < border; y++) {
+        memcpy(south_row + y * width, south_row, width * sizeof(uint32_t));
+    }
+}
+
+// With constant widths the memsets are inlined into a few wide stores, so
+// runs are not worth merging
+static inline __attribute__((always_inline))
+void cell_row_indexed_kernel(uint8_t* band, size_t width, const uint8_t* walls, size_t cols,
+                             size_t open_width, size_t border) {
+    assert(width == image_width(cols));
+    uint8_t* x = band;
+    memset(x, INDEX_SOLID, border);
+    x += border;
+    for (size_t c = 0; c < cols; c++) {
+        memset(x, INDEX_OPEN, open_width);
+        x += open_width;
+        memset(x, (walls[c] & CELL_EAST_OPEN) ? INDEX_OPEN : INDEX_SOLID, border);
+        x += border;
+    }
+    for (size_t y = 1; y < render_style.open_height; y++) {
+        memcpy(band + y * width, band, width);
+    }
+
+    uint8_t* south_row = band + render_style.open_height * width;
+    x = south_row;
+    memset(x, INDEX_SOLID, border);
+    x += border;
+    for (size_t c = 0; c < cols; c++) {
+        memset(x, (walls[c] & CELL_SOUTH_OPEN) ? INDEX_OPEN : INDEX_SOLID, open_width);
+        x += open_width;
+        memset(x, INDEX_SOLID, border);
+        x += border;
+    }
+    for (size_t y = 1; y < border; y++) {
+        memcpy(south_row + y * width, south_row, width);
+    }
+}
+
+void render_cell_row_generic(uint32_t* band, size_t width, const uint8_t* walls, size_t cols) {
+    cell_row_kernel(band, width, walls, cols, render_style.open_width, render_style.border);
+}
+
+void render_cell_row_indexed_generic(uint8_t* band, size_t width, const uint8_t* walls, size_t cols) {
+    cell_row_indexed_kernel(band, width, walls, cols, render_style.open_width, render_style.border);
+}
+
+typedef struct {
+    const char* name;
+    size_t open_width;
+    size_t border;
+    void (*row)(uint32_t* band, size_t width, const uint8_t* walls, size_t cols);
+    void (*indexed)(uint8_t* band, size_t width, const uint8_t* walls, size_t cols);
+} RenderKernels;
+
+// Only the widths are specialized: the cell height just sets how often a
+// finished row is copied
+#define DEFINE_RENDER_KERNELS(suffix, open_width, border)                                                   \
+    static void render_cell_row_##suffix(uint32_t* band, size_t width, const uint8_t* walls, size_t cols) { \
+        cell_row_kernel(band, width, walls, cols, open_width, border);                                     \
+    }                                                                                                      \
+    static void render_cell_row_indexed_##suffix(uint8_t* band, size_t width, const uint8_t* walls,        \
+                                                 size_t cols) {                                            \
+        cell_row_indexed_kernel(band, width, walls, cols, open_width, border);                             \
+    }
+
+DEFINE_RENDER_KERNELS(default, DEFAULT_OPEN_WIDTH, DEFAULT_BORDER_THICKNESS)
+DEFINE_RENDER_KERNELS(1x1, 1, 1)
+DEFINE_RENDER_KERNELS(2x1, 2, 1)
+DEFINE_RENDER_KERNELS(4x1, 4, 1)
+DEFINE_RENDER_KERNELS(8x1, 8, 1)
+DEFINE_RENDER_KERNELS(16x1, 16, 1)
+DEFINE_RENDER_KERNELS(32x1, 32, 1)
+
+#define RENDER_KERNELS(suffix, name, open_width, border) \
+    { name, open_width, border, render_cell_row_##suffix, render_cell_row_indexed_##suffix }
+
+// Searched in order, so the defaults win over an identical entry further down
+static const RenderKernels render_kernels[] = {
+    RENDER_KERNELS(default, "default", DEFAULT_OPEN_WIDTH, DEFAULT_BORDER_THICKNESS),
+    RENDER_KERNELS(1x1, "1x1", 1, 1),
+    RENDER_KERNELS(2x1, "2x1", 2, 1),
+    RENDER_KERNELS(4x1, "4x1", 4, 1),
+    RENDER_KERNELS(8x1, "8x1", 8, 1),
+    RENDER_KERNELS(16x1, "16x1", 16, 1),
+    RENDER_KERNELS(32x1, "32x1", 32, 1),
+};
+
+static const RenderKernels render_generic_kernels = {
+    "generic", 0, 0, render_cell_row_generic, render_cell_row_indexed_generic,
+};
+
+// Matches the default style, so nothing has to be selected before drawing
+static const RenderKernels* render_selected_kernels = &render_kernels[0];
+
+bool render_set_style(RenderStyle style) {
+    if (style.open_width == 0 || style.open_height == 0 || style.border == 0 ||
+        style.solid > 0xFFFFFF || style.open > 0xFFFFFF || style.solid == style.open) {
+        return false;
+    }
+    render_style = style;
+    render_selected_kernels = &render_generic_kernels;
+    for (size_t i = 0; i < sizeof(render_kernels) / sizeof(render_kernels[0]); i++) {
+        if (render_kernels[i].open_width == style.open_width && render_kernels[i].border == style.border) {
+            render_selected_kernels = &render_kernels[i];
+            break;
+        }
+    }
+    return true;
+}
+
+const char* render_kernel_name(void) {
+    return render_selected_kernels->name;
+}
+
+void render_cell_row(uint32_t* band, size_t width, const uint8_t* walls, size_t cols) {
+    render_selected_kernels->row(band, width, walls, cols);
+}
+
+void render_cell_row_indexed(uint8_t* band, size_t width, const uint8_t* walls, size_t cols) {
+    render_selected_kernels->indexed(band, width, walls, cols);
+}
+
+// Unpacks the wall bits of row `r` to one byte per cell
+static void maze_row_walls(const Maze* maze, size_t r, uint8_t* walls) {
+    size_t ind = to_ind(maze, r, 0);
+    for (size_t c = 0; c < maze->cols; c++) {
+        walls[c] = maze_cell(maze, ind + c);
+    }
+}
+
+// Cell rows a render thread claims at a time
+#define RENDER_BAND_ROWS 16
+
+typedef struct {
+    Image* img;
+    const Maze* maze;
+    // First cell row nobody has claimed yet
+    size_t next_row;
+} RenderJob;
+
+// The maze is only read and every band of the image has a single writer,
+// so the workers need nothing but the shared row counter
+static void* render_worker(void* arg) {
+    RenderJob* job = (RenderJob*)arg;
+    const Maze* maze = job->maze;
+    size_t width = job->img->width;
+    uint8_t* walls = (uint8_t*)alloc_or_die(maze->cols, sizeof(uint8_t), "the maze row");
+    for (;;) {
+        size_t first = __atomic_fetch_add(&job->next_row, RENDER_BAND_ROWS, __ATOMIC_RELAXED);
+        if (first >= maze->rows) break;
+        size_t last = maze->rows - first < RENDER_BAND_ROWS ? maze->rows : first + RENDER_BAND_ROWS;
+        uint32_t* band = job->img->pixels + width * (render_style.border + first * CELL_ROW_HEIGHT);
+        for (size_t r = first; r < last; r++, band += width * CELL_ROW_HEIGHT) {
+            maze_row_walls(maze, r, walls);
+            render_cell_row(band, width, walls, maze->cols);
+        }
+    }
+    free(walls);
+    return NULL;
+}
+
+void render_maze_threaded(Image* img, const Maze* maze, size_t threads) {
+    assert(img->width == image_width(maze->cols));
+    assert(img->height == image_height(maze->rows));
+    fill_span(img->pixels, img->width * render_style.border, render_style.solid);
+
+    RenderJob job = { .img = img, .maze = maze, .next_row = 0 };
+    size_t bands = (maze->rows + RENDER_BAND_ROWS - 1) / RENDER_BAND_ROWS;
+    if (threads > bands) threads = bands;
+    run_workers(render_worker, &job, threads);
+}
+
+void render_maze(Image* img, const Maze* maze) {
+    render_maze_threaded(img, maze, 1);
+}
+
+// Draws the rows of a window of the image as palette indices, one at a time.
+// Each row of cells the window crosses is rendered once, and only the cells
+// under the window.
+typedef struct {
+    const Maze* maze;
+    // The cells drawn from every row and the pixels of them left of the window
+    size_t first_col;
+    size_t cols;
+    size_t skip;
+    size_t band_width;
+    // Cell row the band holds, SIZE_MAX before the first
+    size_t drawn_row;
+    uint8_t* band;
+    uint8_t* walls;
+    // The top border, all wall
+    uint8_t* solid;
+} WindowBand;
+
+static WindowBand window_band_init(const Maze* maze, size_t x, size_t width) {
+    assert(width > 0 && x + width <= image_width(maze->cols));
+    size_t period = render_style.open_width + render_style.border;
+    // The wall left of the first cell depends on its west neighbor, so the
+    // band starts one cell early unless that is the edge of the maze
+    size_t first = x / period;
+    if (first > 0) first--;
+    size_t last = (x + width - 1) / period;
+    WindowBand window = {
+        .maze = maze,
+        .first_col = first,
+        .cols = (last < maze->cols ? last + 1 : maze->cols) - first,
+        .skip = x - first * period,
+        .drawn_row = SIZE_MAX,
+    };
+    window.band_width = image_width(window.cols);
+    window.band = (uint8_t*)alloc_or_die(window.band_width * CELL_ROW_HEIGHT, sizeof(uint8_t), "the pixel band");
+    window.walls = (uint8_t*)alloc_or_die(window.cols, sizeof(uint8_t), "the maze row");
+    window.solid = (uint8_t*)alloc_or_die(width, sizeof(uint8_t), "the image row");
+    memset(window.solid, INDEX_SOLID, width);
+    return window;
+}
+
+// Row `y` of the image, from the left edge of the window on
+static const uint8_t* window_band_row(WindowBand* window, size_t y) {
+    size_t border = render_style.border;
+    if (y < border) return window->solid;
+    size_t r = (y - border) / CELL_ROW_HEIGHT;
+    if (r != window->drawn_row) {
+        size_t ind = to_ind(window->maze, r, window->first_col);
+        for (size_t c = 0; c < window->cols; c++) window->walls[c] = maze_cell(window->maze, ind + c);
+        render_cell_row_indexed(window->band, window->band_width, window->walls, window->cols);
+        window->drawn_row = r;
+    }
+    return window->band + (y - border) % CELL_ROW_HEIGHT * window->band_width + window->skip;
+}
+
+static void window_band_deinit(WindowBand* window) {
+    free(window->solid);
+    free(window->walls);
+    free(window->band);
+    *window = (WindowBand) {0};
+}
+
+void render_window_indexed(const Maze* maze, uint8_t* indices, size_t x, size_t y, size_t width, size_t height) {
+    assert(y + height <= image_height(maze->rows));
+    if (width == 0 || height == 0) return;
+    WindowBand window = window_band_init(maze, x, width);
+    for (size_t py = y; py < y + height; py++, indices += width) {
+        memcpy(indices, window_band_row(&window, py), width);
+    }
+    window_band_deinit(&window);
+}
+
+// Rounded share of wall in a block, as a shade
+static inline uint8_t block_shade(uint64_t solid, uint64_t area) {
+    return (uint8_t)((solid * (2 * SHADE_SOLID) + area) / (2 * area));
+}
+
+// Blocks up to this many pixels on a side are shaded by drawing the pixels
+// under them and adding them up; larger ones by counting open walls in the
+// cell bits, which costs the same per row of cells however wide the blocks are
+#define SHADE_DRAWN_MAX_BLOCK 8
+
+// Shades of the blocks between consecutive edges, `xs` and `ys` holding
+// `width + 1` and `height + 1` increasing image coordinates, from the drawn
+// pixels. Each block row adds up its image rows column by column, and then
+// the columns left to right, so every block is one difference. A column of a
+// block has at most SHADE_DRAWN_MAX_BLOCK wall pixels, so the column counts
+// are bytes and eight of them are added at once in a word.
+static void shade_blocks_drawn(const Maze* maze, uint8_t* shades, const size_t* xs, size_t width, const size_t* ys,
+                               size_t height) {
+    enum { MAX_AREA = SHADE_DRAWN_MAX_BLOCK * SHADE_DRAWN_MAX_BLOCK };
+    // Shades by wall pixels for every block area met so far, as dividing for
+    // each block would take longer than adding it up
+    uint8_t shade_of[MAX_AREA + 1][MAX_AREA + 1];
+    bool known[MAX_AREA + 1] = {0};
+    size_t span = xs[width] - xs[0];
+    WindowBand window = window_band_init(maze, xs[0], span);
+    uint8_t* counts = (uint8_t*)alloc_or_die(span, sizeof(uint8_t), "the column counts");
+    uint32_t* sums = (uint32_t*)alloc_or_die(span + 1, sizeof(uint32_t), "the column sums");
+    for (size_t by = 0; by < height; by++, shades += width) {
+        memset(counts, 0, span);
+        for (size_t py = ys[by]; py < ys[by + 1]; py++) {
+            const uint8_t* row = window_band_row(&window, py);
+            size_t i = 0;
+            for (; i + sizeof(uint64_t) <= span; i += sizeof(uint64_t)) {
+                uint64_t count, pixels;
+                memcpy(&count, counts + i, sizeof(count));
+                memcpy(&pixels, row + i, sizeof(pixels));
+                count += pixels;
+                memcpy(counts + i, &count, sizeof(count));
+            }
+            for (; i < span; i++) counts[i] += row[i];
+        }
+        for (size_t i = 0; i < span; i++) sums[i + 1] = sums[i] + counts[i];
+        for (size_t bx = 0; bx < width; bx++) {
+            size_t area = (xs[bx + 1] - xs[bx]) * (ys[by + 1] - ys[by]);
+            if (!known[area]) {
+                for (size_t solid = 0; solid <= area; solid++) shade_of[area][solid] = block_shade(solid, area);
+                known[area] = true;
+            }
+            shades[bx] = shade_of[area][sums[xs[bx + 1] - xs[0]] - sums[xs[bx] - xs[0]]];
+        }
+    }
+    free(sums);
+    free(counts);
+    window_band_deinit(&window);
+}
+
+// Where a block edge falls in the image: `offset` pixels past the start of
+// wall column `col`, which is followed by the open part of cell `col`
+typedef struct {
+    size_t col;
+    size_t offset;
+    // Pixels of open cell interior in an image row up to the edge, counted
+    // from the wall column of the first edge; only differences are used
+    uint64_t interior;
+} BlockEdge;
+
+// A stretch of the grid 32 cells to a word, with the number of cells that
+// have one wall open in all words before each word, so that any count of
+// open walls in it takes one popcount
+typedef struct {
+    const uint64_t* words;
+    const uint64_t* before;
+    // Grid index of the first cell of words[0]
+    size_t base;
+    // CELL_EAST_OPEN or CELL_SOUTH_OPEN repeated over the word
+    uint64_t mask;
+} CellWords;
+
+#define CELL_WORD_CELLS 32
+
+// Set bits of a word masked to one bit per cell. __builtin_popcountll is a
+// library call unless the target has an instruction for it, and with at
+// most one bit in each pair the first step of counting comes for free.
+static inline uint64_t count_cell_bits(uint64_t word) {
+    word = (word | word >> 1) & 0x5555555555555555u;
+    word = (word & 0x3333333333333333u) + (word >> 2 & 0x3333333333333333u);
+    word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0Fu;
+    return word * 0x0101010101010101u >> 56;
+}
+
+// Loads the words holding grid cells `first` to `last`
+static CellWords load_cell_words(const Maze* maze, size_t first, size_t last, uint8_t wall, uint64_t* words,
+                                 uint64_t* before) {
+    size_t grid_bytes = (maze->rows * maze->cols + CELLS_PER_BYTE - 1) / CELLS_PER_BYTE;
+    CellWords span = {
+        .words = words,
+        .before = before,
+        .base = first / CELL_WORD_CELLS * CELL_WORD_CELLS,
+        .mask = (wall == CELL_EAST_OPEN ? 0x55 : 0xAA) * 0x0101010101010101u,
+    };
+    uint64_t count = 0;
+    for (size_t k = first / CELL_WORD_CELLS, i = 0; k <= last / CELL_WORD_CELLS; k++, i++) {
+        const uint8_t* bytes = maze->cells + k * sizeof(uint64_t);
+        // The last words may run past the end of the grid
+        size_t n = grid_bytes > k * sizeof(uint64_t) ? grid_bytes - k * sizeof(uint64_t) : 0;
+        uint64_t word = 0;
+        // Cell 0 in the low bits whatever the byte order
+        if (n >= sizeof(uint64_t)) {
+            for (size_t j = 0; j < sizeof(uint64_t); j++) word |= (uint64_t)bytes[j] << 8*j;
+        } else {
+            for (size_t j = 0; j < n; j++) word |= (uint64_t)bytes[j] << 8*j;
+        }
+        words[i] = word;
+        before[i] = count;
+        count += count_cell_bits(word & span.mask);
+    }
+    return span;
+}
+
+// Cells with the wall open from the start of the span up to grid index `ind`
+static inline uint64_t open_before(const CellWords* span, size_t ind) {
+    size_t i = (ind - span->base) / CELL_WORD_CELLS;
+    size_t shift = (ind - span->base) % CELL_WORD_CELLS * CELL_BITS;
+    return span->before[i] + count_cell_bits(span->words[i] & span->mask & (((uint64_t)1 << shift) - 1));
+}
+
+// 1 if cell `ind` has the wall open, 0 if not
+static inline uint64_t open_at(const CellWords* span, size_t ind) {
+    size_t i = (ind - span->base) / CELL_WORD_CELLS;
+    size_t shift = (ind - span->base) % CELL_WORD_CELLS * CELL_BITS;
+    return ((span->words[i] & span->mask) >> shift & 3) != 0;
+}
+
+// Adds the open pixels of `run` image rows through the open part of cell row
+// `r` to every block: the interiors, and the wall column after every cell
+// with CELL_EAST_OPEN. Wall column c comes after cell c - 1, and wall column
+// 0 after none, so it counts like column 1 with nothing open yet.
+static void add_cell_row_run(const Maze* maze, size_t r, const BlockEdge* edges, size_t width, uint64_t* open,
+                             size_t run, uint64_t* words, uint64_t* before) {
+    size_t border = render_style.border;
+    size_t ind = to_ind(maze, r, 0);
+    size_t first = ind + (edges[0].col > 0 ? edges[0].col - 1 : 0);
+    size_t last = ind + (edges[width].col > 0 ? edges[width].col - 1 : 0);
+    CellWords span = load_cell_words(maze, first, last, CELL_EAST_OPEN, words, before);
+    uint64_t previous = 0;
+    for (size_t j = 0; j <= width; j++) {
+        const BlockEdge* edge = &edges[j];
+        size_t west = edge->col > 0 ? ind + edge->col - 1 : ind;
+        uint64_t partial = edge->offset < border ? edge->offset : border;
+        uint64_t total = edge->interior + border * open_before(&span, west) +
+                         partial * (open_at(&span, west) & (edge->col > 0));
+        if (j > 0) open[j - 1] += (total - previous) * run;
+        previous = total;
+    }
+}
+
+// Adds the open pixels of `run` image rows through the wall south of cell
+// row `r`: the stretches under cells with CELL_SOUTH_OPEN
+static void add_wall_row_run(const Maze* maze, size_t r, const BlockEdge* edges, size_t width, uint64_t* open,
+                             size_t run, uint64_t* words, uint64_t* before) {
+    size_t border = render_style.border;
+    size_t open_width = render_style.open_width;
+    size_t ind = to_ind(maze, r, 0);
+    CellWords span = load_cell_words(maze, ind + edges[0].col, ind + edges[width].col, CELL_SOUTH_OPEN, words,
+                                     before);
+    uint64_t previous = 0;
+    for (size_t j = 0; j <= width; j++) {
+        const BlockEdge* edge = &edges[j];
+        // An edge in the last wall column is past every cell of the row
+        uint64_t partial = edge->offset > border && edge->col < maze->cols ? edge->offset - border : 0;
+        uint64_t total = open_width * open_before(&span, ind + edge->col) +
+                         partial * open_at(&span, ind + edge->col);
+        if (j > 0) open[j - 1] += (total - previous) * run;
+        previous = total;
+    }
+}
+
+// The same from the cell bits. Each image row a block covers is one of three
+// kinds (the top border, the open part of a cell row, or the wall under
+// one), and all rows of a kind in a block have the same open pixels, so one
+// count per run of rows is enough.
+static void shade_blocks_counted(const Maze* maze, uint8_t* shades, const size_t* xs, size_t width,
+                                 const size_t* ys, size_t height) {
+    size_t border = render_style.border;
+    size_t open_width = render_style.open_width;
+    size_t open_height = render_style.open_height;
+    size_t period = open_width + border;
+    BlockEdge* edges = (BlockEdge*)alloc_or_die(width + 1, sizeof(BlockEdge), "the block edges");
+    for (size_t j = 0; j <= width; j++) {
+        size_t col = xs[j] / period;
+        size_t offset = xs[j] % period;
+        edges[j] = (BlockEdge) {
+            .col = col,
+            .offset = offset,
+            .interior = (uint64_t)(col - xs[0] / period) * open_width + (offset > border ? offset - border : 0),
+        };
+    }
+
+    // Enough words for every cell the blocks cross, and the one before them
+    size_t word_count = (edges[width].col - edges[0].col + 1) / CELL_WORD_CELLS + 3;
+    uint64_t* words = (uint64_t*)alloc_or_die(word_count, sizeof(uint64_t), "the cell words");
+    uint64_t* before = (uint64_t*)alloc_or_die(word_count, sizeof(uint64_t), "the cell words");
+    uint64_t* open = (uint64_t*)alloc_or_die(width, sizeof(uint64_t), "the block counts");
+    for (size_t by = 0; by < height; by++, shades += width) {
+        memset(open, 0, width * sizeof(uint64_t));
+        size_t py = ys[by] > border ? ys[by] : border;
+        while (py < ys[by + 1]) {
+            size_t r = (py - border) / CELL_ROW_HEIGHT;
+            size_t row_top = border + r * CELL_ROW_HEIGHT;
+            bool interior = py - row_top < open_height;
+            size_t end = row_top + (interior ? open_height : CELL_ROW_HEIGHT);
+            if (end > ys[by + 1]) end = ys[by + 1];
+            if (interior) {
+                add_cell_row_run(maze, r, edges, width, open, end - py, words, before);
+            } else {
+                add_wall_row_run(maze, r, edges, width, open, end - py, words, before);
+            }
+            py = end;
+        }
+        for (size_t bx = 0; bx < width; bx++) {
+            uint64_t area = (uint64_t)(xs[bx + 1] - xs[bx]) * (ys[by + 1] - ys[by]);
+            shades[bx] = block_shade(area - open[bx], area);
+        }
+    }
+    free(open);
+    free(before);
+    free(words);
+    free(edges);
+}
+
+static void shade_blocks(const Maze* maze, uint8_t* shades, const size_t* xs, size_t width, const size_t* ys,
+                         size_t height) {
+    if (width == 0 || height == 0) return;
+    bool small = true;
+    for (size_t i = 0; i < width && small; i++) small = xs[i + 1] - xs[i] <= SHADE_DRAWN_MAX_BLOCK;
+    for (size_t i = 0; i < height && small; i++) small = ys[i + 1] - ys[i] <= SHADE_DRAWN_MAX_BLOCK;
+    if (small) {
+        shade_blocks_drawn(maze, shades, xs, width, ys, height);
+    } else {
+        shade_blocks_counted(maze, shades, xs, width, ys, height);
+    }
+}
+
+void render_window_shaded(const Maze* maze, uint8_t* shades, size_t x, size_t y, size_t width, size_t height,
+                          size_t scale) {
+    size_t image_w = image_width(maze->cols);
+    size_t image_h = image_height(maze->rows);
+    assert(scale > 0);
+    assert(x + width <= (image_w + scale - 1) / scale);
+    assert(y + height <= (image_h + scale - 1) / scale);
+    size_t* xs = (size_t*)alloc_or_die(width + 1, sizeof(size_t), "the block edges");
+    size_t* ys = (size_t*)alloc_or_die(height + 1, sizeof(size_t), "the block edges");
+    for (size_t i = 0; i <= width; i++) xs[i] = (x + i) * scale < image_w ? (x + i) * scale : image_w;
+    for (size_t i = 0; i <= height; i++) ys[i] = (y + i) * scale < image_h ? (y + i) * scale : image_h;
+    shade_blocks(maze, shades, xs, width, ys, height);
+    free(ys);
+    free(xs);
+}
+
+static const char* image_format_names[FORMAT_COUNT] = {
+    [FORMAT_PPM] = "ppm",
+    [FORMAT_PGM] = "pgm",
+    [FORMAT_PBM] = "pbm",
+    [FORMAT_PNG] = "png",
+};
+
+const char* image_format_name(ImageFormat format) {
+    assert(format < FORMAT_COUNT);
+    return image_format_names[format];
+}
+
+bool image_format_from_name(const char* name, ImageFormat* format) {
+    for (size_t i = 0; i < FORMAT_COUNT; i++) {
+        if (strcmp(name, image_format_names[i]) == 0) {
+            *format = (ImageFormat)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Luma of a 0xRRGGBB color, for PGM output
+#define GRAY(color) ((((color) >> 16 & 0xFF) * 77 + ((color) >> 8 & 0xFF) * 150 + ((color) & 0xFF) * 29) >> 8)
+
+static void put_be32(uint8_t* dst, uint32_t value) {
+    dst[0] = value >> 24;
+    dst[1] = value >> 16;
+    dst[2] = value >> 8;
+    dst[3] = value;
+}
+
+static void image_writer_put(ImageWriter* writer, const void* bytes, size_t count) {
+    if (fwrite(bytes, 1, count, writer->fp) != count) {
+        fprintf(stderr, "ERROR: Failed to write the image\n");
+        exit(74); // UNIX sysexit.h error code 74
+    }
+    INSTR_ADD(bytes_written, count);
+}
+
+// Writes one PNG chunk made of `count` pieces, so IDAT data does not have to
+// be copied next to its framing first
+static void png_chunk(ImageWriter* writer, const char* type, const uint8_t** pieces, const size_t* sizes, size_t count) {
+    uint8_t head[8];
+    size_t length = 0;
+    for (size_t i = 0; i < count; i++) length += sizes[i];
+    put_be32(head, (uint32_t)length);
+    memcpy(head + 4, type, 4);
+    image_writer_put(writer, head, sizeof(head));
+    uint32_t crc = crc32_update(0, head + 4, 4);
+    for (size_t i = 0; i < count; i++) {
+        image_writer_put(writer, pieces[i], sizes[i]);
+        crc = crc32_update(crc, pieces[i], sizes[i]);
+    }
+    uint8_t tail[4];
+    put_be32(tail, crc);
+    image_writer_put(writer, tail, sizeof(tail));
+}
+
+// 0xRRGGBB blend of the two colors for a shade
+static uint32_t shade_color(uint8_t shade) {
+    uint32_t color = 0;
+    for (int shift = 0; shift < 24; shift += 8) {
+        uint32_t open = (render_style.open >> shift) & 0xFF;
+        uint32_t solid = (render_style.solid >> shift) & 0xFF;
+        color |= ((open * (SHADE_SOLID - shade) + solid * shade + SHADE_SOLID / 2) / SHADE_SOLID) << shift;
+    }
+    return color;
+}
+
+static void png_header(ImageWriter* writer, size_t width, size_t height) {
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    image_writer_put(writer, signature, sizeof(signature));
+
+    // 1 bit per pixel (8 when shaded), indexed color, deflate, no interlacing
+    uint8_t ihdr[13] = { [8] = writer->shaded ? 8 : 1, [9] = 3 };
+    put_be32(ihdr, (uint32_t)width);
+    put_be32(ihdr + 4, (uint32_t)height);
+    const uint8_t* piece = ihdr;
+    size_t size = sizeof(ihdr);
+    png_chunk(writer, "IHDR", &piece, &size, 1);
+
+    uint32_t open = render_style.open;
+    uint32_t solid = render_style.solid;
+    uint8_t plte[3 * (SHADE_SOLID + 1)] = {
+        [3*INDEX_OPEN + 0]  = (open >> 16) & 0xFF,
+        [3*INDEX_OPEN + 1]  = (open >> 8) & 0xFF,
+        [3*INDEX_OPEN + 2]  = open & 0xFF,
+        [3*INDEX_SOLID + 0] = (solid >> 16) & 0xFF,
+        [3*INDEX_SOLID + 1] = (solid >> 8) & 0xFF,
+        [3*INDEX_SOLID + 2] = solid & 0xFF,
+    };
+    size = 6;
+    if (writer->shaded) {
+        // The palette index is the shade itself
+        for (size_t i = 0; i <= SHADE_SOLID; i++) {
+            uint32_t color = writer->shade_colors[i];
+            plte[3*i + 0] = (color >> 16) & 0xFF;
+            plte[3*i + 1] = (color >> 8) & 0xFF;
+            plte[3*i + 2] = color & 0xFF;
+        }
+        size = sizeof(plte);
+    }
+    piece = plte;
+    png_chunk(writer, "PLTE", &piece, &size, 1);
+}
+
+// PNG image data is a zlib stream; the rows are stored in it uncompressed,
+// one stored block of at most 65535 bytes per IDAT chunk
+#define PNG_STORED_BLOCK 65535
+
+static void png_idat(ImageWriter* writer, const uint8_t* data, size_t length, bool last) {
+    if (length == 0 && !last) return;
+    do {
+        size_t block = length < PNG_STORED_BLOCK ? length : PNG_STORED_BLOCK;
+        bool final = last && block == length;
+        uint8_t frame[7];
+        size_t framing = 0;
+        if (!writer->idat_started) {
+            // Deflate with a 32K window, no preset dictionary
+            frame[framing++] = 0x78;
+            frame[framing++] = 0x01;
+            writer->idat_started = true;
+        }
+        frame[framing++] = final ? 1 : 0;
+        frame[framing++] = block & 0xFF;
+        frame[framing++] = block >> 8;
+        frame[framing++] = ~block & 0xFF;
+        frame[framing++] = (~block >> 8) & 0xFF;
+        uint8_t adler[4];
+        put_be32(adler, (writer->adler_b << 16) | writer->adler_a);
+        const uint8_t* pieces[3] = { frame, data, adler };
+        size_t sizes[3] = { framing, block, final ? sizeof(adler) : 0 };
+        png_chunk(writer, "IDAT", pieces, sizes, 3);
+        data += block;
+        length -= block;
+    } while (length > 0);
+}
+
+static void adler_update(ImageWriter* writer, const uint8_t* bytes, size_t count) {
+    uint32_t a = writer->adler_a;
+    uint32_t b = writer->adler_b;
+    while (count > 0) {
+        // 5552 bytes is the most that can be summed before b overflows
+        size_t n = count < 5552 ? count : 5552;
+        for (size_t i = 0; i < n; i++) {
+            a += bytes[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        bytes += n;
+        count -= n;
+    }
+    writer->adler_a = a;
+    writer->adler_b = b;
+}
+
+static size_t pnm_row_bytes(ImageFormat format, size_t width) {
+    switch (format) {
+    case FORMAT_PPM: return width * 3;
+    case FORMAT_PGM: return width;
+    case FORMAT_PBM: return (width + 7) / 8;
+    default: assert(false && "unreachable");
+    }
+    return 0;
+}
+
+static size_t pnm_header(char* header, size_t size, ImageFormat format, size_t width, size_t height) {
+    int length = 0;
+    switch (format) {
+    case FORMAT_PPM: length = snprintf(header, size, "P6\n%zu %zu 255\n", width, height); break;
+    case FORMAT_PGM: length = snprintf(header, size, "P5\n%zu %zu 255\n", width, height); break;
+    case FORMAT_PBM: length = snprintf(header, size, "P4\n%zu %zu\n", width, height); break;
+    default: assert(false && "unreachable");
+    }
+    return (size_t)length;
+}
+
+static ImageWriter image_writer_start(const char* filename, ImageFormat format, size_t width, size_t height,
+                                      bool shaded) {
+    ImageWriter writer = { .shaded = shaded };
+    if (format == FORMAT_PNG && (width > INT32_MAX || height > INT32_MAX)) {
+        fprintf(stderr, "ERROR: A %zux%zu image is too large for PNG\n", width, height);
+        exit(65); // UNIX sysexit.h error code 65
+    }
+    writer.fp = fopen(filename, "wb");
+    if (writer.fp == NULL) {
+        fprintf(stderr, "ERROR: Failed to open '%s' for writing\n", filename);
+        exit(72); // UNIX sysexit.h error code 72
+    }
+    writer.format = format;
+    writer.width = width;
+    if (format != FORMAT_PNG) {
+        writer.row_bytes = pnm_row_bytes(format, width);
+    } else {
+        writer.row_bytes = 1 + (shaded ? width : (width + 7) / 8);
+    }
+    // Whole rows only, at least one of them and no more than the image has,
+    // which matters for small tiles
+    size_t buffer_rows = IMAGE_WRITER_BUFFER_SIZE / writer.row_bytes;
+    if (buffer_rows > height) buffer_rows = height;
+    if (buffer_rows == 0) buffer_rows = 1;
+    writer.capacity = buffer_rows * writer.row_bytes;
+    writer.bytes = (uint8_t*)alloc_or_die(writer.capacity, sizeof(uint8_t), "the image buffer");
+    writer.indices = (uint8_t*)alloc_or_die(width, sizeof(uint8_t), "the image row");
+    if (shaded) {
+        writer.shade_colors = (uint32_t*)alloc_or_die(SHADE_SOLID + 1, sizeof(uint32_t), "the shade colors");
+        for (size_t i = 0; i <= SHADE_SOLID; i++) writer.shade_colors[i] = shade_color((uint8_t)i);
+    }
+    writer.adler_a = 1;
+    // The buffer already batches the writes, stdio would only copy them again
+    setvbuf(writer.fp, NULL, _IONBF, 0);
+
+    if (format == FORMAT_PNG) {
+        png_header(&writer, width, height);
+    } else {
+        char header[64];
+        image_writer_put(&writer, header, pnm_header(header, sizeof(header), format, width, height));
+    }
+    return writer;
+}
+
+ImageWriter image_writer_open(const char* filename, ImageFormat format, size_t width, size_t height) {
+    return image_writer_start(filename, format, width, height, false);
+}
+
+ImageWriter image_writer_open_shaded(const char* filename, ImageFormat format, size_t width, size_t height) {
+    return image_writer_start(filename, format, width, height, true);
+}
+
+void pack_rgb24(uint8_t* dst, const uint32_t* src, size_t count) {
+    size_t i = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // Four pixels at a time as three 32-bit words. Byte swapping 0x00RRGGBB
+    // and dropping the low byte leaves R, G, B in memory order.
+    for (; i + 4 <= count; i += 4, dst += 12) {
+        uint32_t p0 = __builtin_bswap32(src[i + 0]) >> 8;
+        uint32_t p1 = __builtin_bswap32(src[i + 1]) >> 8;
+        uint32_t p2 = __builtin_bswap32(src[i + 2]) >> 8;
+        uint32_t p3 = __builtin_bswap32(src[i + 3]) >> 8;
+        uint32_t words[3] = {
+            p0 | (p1 << 24),
+            (p1 >> 8) | (p2 << 16),
+            (p2 >> 16) | (p3 << 8),
+        };
+        memcpy(dst, words, sizeof(words));
+    }
+#endif
+    for (; i < count; i++, dst += 3) {
+        // Color HEX code format: 0xRRGGBB
+        dst[0] = (src[i] >> 8*2) & 0xFF;
+        dst[1] = (src[i] >> 8*1) & 0xFF;
+        dst[2] = (src[i] >> 8*0) & 0xFF;
+    }
+}
+
+// Packs palette indices eight to a byte, first pixel in the highest bit
+static void pack_bits(uint8_t* dst, const uint8_t* indices, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        *dst++ = (uint8_t)(indices[i + 0] << 7 | indices[i + 1] << 6 | indices[i + 2] << 5 | indices[i + 3] << 4 |
+                           indices[i + 4] << 3 | indices[i + 5] << 2 | indices[i + 6] << 1 | indices[i + 7]);
+    }
+    if (i < count) {
+        uint8_t last = 0;
+        for (size_t bit = 7; i < count; i++, bit--) last |= indices[i] << bit;
+        *dst = last;
+    }
+}
+
+static void image_writer_flush(ImageWriter* writer, bool last) {
+    if (writer->format == FORMAT_PNG) {
+        png_idat(writer, writer->bytes, writer->length, last);
+    } else if (writer->length > 0) {
+        image_writer_put(writer, writer->bytes, writer->length);
+    }
+    writer->length = 0;
+}
+
+// Makes room for one more encoded row and returns where it goes
+static uint8_t* image_writer_row(ImageWriter* writer) {
+    if (writer->length + writer->row_bytes > writer->capacity) image_writer_flush(writer, false);
+    uint8_t* row = writer->bytes + writer->length;
+    writer->length += writer->row_bytes;
+    return row;
+}
+
+// Encodes one row of palette indices as PPM, PGM or PBM pixels
+static void encode_pnm_row(ImageFormat format, size_t width, uint8_t* dst, const uint8_t* indices) {
+    const uint32_t colors[2] = { [INDEX_OPEN] = render_style.open, [INDEX_SOLID] = render_style.solid };
+    const uint8_t gray[2] = { [INDEX_OPEN] = GRAY(colors[INDEX_OPEN]), [INDEX_SOLID] = GRAY(colors[INDEX_SOLID]) };
+    switch (format) {
+    case FORMAT_PPM:
+        for (size_t x = 0; x < width; x++, dst += 3) {
+            uint32_t color = colors[indices[x]];
+            dst[0] = (color >> 8*2) & 0xFF;
+            dst[1] = (color >> 8*1) & 0xFF;
+            dst[2] = (color >> 8*0) & 0xFF;
+        }
+        break;
+    case FORMAT_PGM:
+        for (size_t x = 0; x < width; x++) dst[x] = gray[indices[x]];
+        break;
+    case FORMAT_PBM:
+        pack_bits(dst, indices, width);
+        break;
+    default: assert(false && "unreachable");
+    }
+}
+
+static void encode_indexed_row(ImageWriter* writer, uint8_t* dst, const uint8_t* indices) {
+    if (writer->format == FORMAT_PNG) {
+        // Filter type 0: the row as is
+        dst[0] = 0;
+        pack_bits(dst + 1, indices, writer->width);
+        adler_update(writer, dst, writer->row_bytes);
+        return;
+    }
+    encode_pnm_row(writer->format, writer->width, dst, indices);
+}
+
+void image_writer_write_indexed(ImageWriter* writer, const uint8_t* indices, size_t rows) {
+    assert(!writer->shaded);
+    for (size_t y = 0; y < rows; y++, indices += writer->width) {
+        encode_indexed_row(writer, image_writer_row(writer), indices);
+    }
+}
+
+// PBM has no shades, so a pixel that is at least half wall is drawn as wall
+static void encode_shaded_row(ImageWriter* writer, uint8_t* dst, const uint8_t* shades) {
+    size_t width = writer->width;
+    switch (writer->format) {
+    case FORMAT_PPM:
+        for (size_t x = 0; x < width; x++, dst += 3) {
+            uint32_t color = writer->shade_colors[shades[x]];
+            dst[0] = (color >> 8*2) & 0xFF;
+            dst[1] = (color >> 8*1) & 0xFF;
+            dst[2] = (color >> 8*0) & 0xFF;
+        }
+        break;
+    case FORMAT_PGM:
+        for (size_t x = 0; x < width; x++) dst[x] = GRAY(writer->shade_colors[shades[x]]);
+        break;
+    case FORMAT_PBM:
+        for (size_t x = 0; x < width; x++) writer->indices[x] = shades[x] > SHADE_SOLID / 2 ? INDEX_SOLID : INDEX_OPEN;
+        pack_bits(dst, writer->indices, width);
+        break;
+    case FORMAT_PNG:
+        dst[0] = 0;
+        memcpy(dst + 1, shades, width);
+        adler_update(writer, dst, writer->row_bytes);
+        break;
+    default: assert(false && "unreachable");
+    }
+}
+
+void image_writer_write_shaded(ImageWriter* writer, const uint8_t* shades, size_t rows) {
+    assert(writer->shaded);
+    for (size_t y = 0; y < rows; y++, shades += writer->width) {
+        encode_shaded_row(writer, image_writer_row(writer), shades);
+    }
+}
+
+void image_writer_write(ImageWriter* writer, const uint32_t* pixels, size_t rows) {
+    assert(!writer->shaded);
+    for (size_t y = 0; y < rows; y++, pixels += writer->width) {
+        uint8_t* dst = image_writer_row(writer);
+        if (writer->format == FORMAT_PPM) {
+            pack_rgb24(dst, pixels, writer->width);
+            continue;
+        }
+        // Anything that is not open counts as wall
+        for (size_t x = 0; x < writer->width; x++) {
+            writer->indices[x] = pixels[x] == render_style.open ? INDEX_OPEN : INDEX_SOLID;
+        }
+        encode_indexed_row(writer, dst, writer->indices);
+    }
+}
+
+void image_writer_close(ImageWriter* writer) {
+    image_writer_flush(writer, true);
+    if (writer->format == FORMAT_PNG) {
+        png_chunk(writer, "IEND", NULL, NULL, 0);
+    }
+    if (fclose(writer->fp) != 0) {
+        fprintf(stderr, "ERROR: Failed to write the image\n");
+        exit(74); // UNIX sysexit.h error code 74
+    }
+    free(writer->bytes);
+    free(writer->indices);
+    free(writer->shade_colors);
+    *writer = (ImageWriter) {0};
+}
+
+void stream_maze_to_file(const Maze* maze, const char* filename, ImageFormat format) {
+    size_t width = image_width(maze->cols);
+    ImageWriter writer = image_writer_open(filename, format, width, image_height(maze->rows));
+    uint8_t* band = (uint8_t*)alloc_or_die(width * CELL_ROW_HEIGHT, sizeof(uint8_t), "the pixel band");
+    uint8_t* walls = (uint8_t*)alloc_or_die(maze->cols, sizeof(uint8_t), "the maze row");
+
+    memset(band, INDEX_SOLID, width * render_style.border);
+    image_writer_write_indexed(&writer, band, render_style.border);
+    for (size_t r = 0; r < maze->rows; r++) {
+        INSTR_PHASE_BEGIN(rasterize);
+        maze_row_walls(maze, r, walls);
+        render_cell_row_indexed(band, width, walls, maze->cols);
+        INSTR_PHASE_END(PHASE_RASTERIZE, rasterize);
+        INSTR_PHASE_BEGIN(encode);
+        image_writer_write_indexed(&writer, band, CELL_ROW_HEIGHT);
+        INSTR_PHASE_END(PHASE_ENCODE, encode);
+    }
+
+    free(walls);
+    free(band);
+    image_writer_close(&writer);
+}
+
+typedef struct {
+    const Maze* maze;
+    ImageFormat format;
+    size_t width;
+    size_t row_bytes;
+    // Start of the first pixel row in the mapping, right after the header
+    uint8_t* pixels;
+    // First cell row nobody has claimed yet
+    size_t next_row;
+} MappedRenderJob;
+
+static void* mapped_render_worker(void* arg) {
+    MappedRenderJob* job = (MappedRenderJob*)arg;
+    const Maze* maze = job->maze;
+    uint8_t* band = (uint8_t*)alloc_or_die(job->width * CELL_ROW_HEIGHT, sizeof(uint8_t), "the pixel band");
+    uint8_t* walls = (uint8_t*)alloc_or_die(maze->cols, sizeof(uint8_t), "the maze row");
+    for (;;) {
+        size_t first = __atomic_fetch_add(&job->next_row, RENDER_BAND_ROWS, __ATOMIC_RELAXED);
+        if (first >= maze->rows) break;
+        size_t last = maze->rows - first < RENDER_BAND_ROWS ? maze->rows : first + RENDER_BAND_ROWS;
+        uint8_t* dst = job->pixels + job->row_bytes * (render_style.border + first * CELL_ROW_HEIGHT);
+        for (size_t r = first; r < last; r++) {
+            maze_row_walls(maze, r, walls);
+            render_cell_row_indexed(band, job->width, walls, maze->cols);
+            for (size_t y = 0; y < CELL_ROW_HEIGHT; y++, dst += job->row_bytes) {
+                encode_pnm_row(job->format, job->width, dst, band + y * job->width);
+            }
+        }
+    }
+    free(walls);
+    free(band);
+    return NULL;
+}
+
+void render_maze_to_mapped_file(const Maze* maze, const char* filename, ImageFormat format, size_t threads) {
+    if (format == FORMAT_PNG) {
+        fprintf(stderr, "ERROR: PNG rows have no fixed offsets, so they can not be written in place\n");
+        exit(64); // UNIX sysexit.h error code 64
+    }
+    size_t width = image_width(maze->cols);
+    size_t height = image_height(maze->rows);
+    char header[64];
+    size_t header_bytes = pnm_header(header, sizeof(header), format, width, height);
+    size_t row_bytes = pnm_row_bytes(format, width);
+    if (height > (SIZE_MAX - header_bytes) / row_bytes) {
+        fprintf(stderr, "ERROR: A %zux%zu image is too large to address\n", width, height);
+        exit(71); // UNIX sysexit.h error code 71
+    }
+    size_t total = header_bytes + row_bytes * height;
+
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: Failed to open '%s' for writing\n", filename);
+        exit(72); // UNIX sysexit.h error code 72
+    }
+    if (ftruncate(fd, (off_t)total) != 0) {
+        fprintf(stderr, "ERROR: Failed to resize '%s' to %zu bytes\n", filename, total);
+        exit(74); // UNIX sysexit.h error code 74
+    }
+    uint8_t* file = (uint8_t*)mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (file == MAP_FAILED) {
+        fprintf(stderr, "ERROR: Failed to map '%s'\n", filename);
+        exit(74); // UNIX sysexit.h error code 74
+    }
+
+    memcpy(file, header, header_bytes);
+    MappedRenderJob job = {
+        .maze = maze,
+        .format = format,
+        .width = width,
+        .row_bytes = row_bytes,
+        .pixels = file + header_bytes,
+        .next_row = 0,
+    };
+    uint8_t* border = (uint8_t*)alloc_or_die(width, sizeof(uint8_t), "the image row");
+    memset(border, INDEX_SOLID, width);
+    for (size_t y = 0; y < render_style.border; y++) {
+        encode_pnm_row(format, width, job.pixels + y * row_bytes, border);
+    }
+    free(border);
+
+    size_t bands = (maze->rows + RENDER_BAND_ROWS - 1) / RENDER_BAND_ROWS;
+    if (threads > bands) threads = bands;
+    run_workers(mapped_render_worker, &job, threads);
+
+    if (munmap(file, total) != 0 || close(fd) != 0) {
+        fprintf(stderr, "ERROR: Failed to write the image\n");
+        exit(74); // UNIX sysexit.h error code 74
+    }
+    INSTR_ADD(bytes_written, total);
+}
+
+// Block rows a shaded crop computes before handing them to the writer
+#define CROP_STRIP_ROWS 64
+
+// Shades the blocks between the edges a strip of block rows at a time and
+// writes them out as they are done
+static void write_shaded_blocks(const Maze* maze, const char* filename, ImageFormat format, const size_t* xs,
+                                size_t width, const size_t* ys, size_t height) {
+    ImageWriter writer = image_writer_open_shaded(filename, format, width, height);
+    size_t strip = height < CROP_STRIP_ROWS ? height : CROP_STRIP_ROWS;
+    uint8_t* shades = (uint8_t*)alloc_or_die(width * strip, sizeof(uint8_t), "the shaded rows");
+    for (size_t by = 0; by < height; by += strip) {
+        size_t rows = height - by < strip ? height - by : strip;
+        shade_blocks(maze, shades, xs, width, ys + by, rows);
+        image_writer_write_shaded(&writer, shades, rows);
+    }
+    free(shades);
+    image_writer_close(&writer);
+}
+
+void render_crop_to_file(const Maze* maze, const char* filename, ImageFormat format, ImageRect crop, size_t scale) {
+    assert(scale > 0 && crop.width > 0 && crop.height > 0);
+    assert(crop.x + crop.width <= image_width(maze->cols));
+    assert(crop.y + crop.height <= image_height(maze->rows));
+    if (scale == 1) {
+        ImageWriter writer = image_writer_open(filename, format, crop.width, crop.height);
+        WindowBand window = window_band_init(maze, crop.x, crop.width);
+        for (size_t y = crop.y; y < crop.y + crop.height; y++) {
+            image_writer_write_indexed(&writer, window_band_row(&window, y), 1);
+        }
+        window_band_deinit(&window);
+        image_writer_close(&writer);
+        return;
+    }
+
+    size_t width = (crop.width + scale - 1) / scale;
+    size_t height = (crop.height + scale - 1) / scale;
+    size_t* xs = (size_t*)alloc_or_die(width + 1, sizeof(size_t), "the block edges");
+    size_t* ys = (size_t*)alloc_or_die(height + 1, sizeof(size_t), "the block edges");
+    for (size_t i = 0; i <= width; i++) xs[i] = crop.x + (i * scale < crop.width ? i * scale : crop.width);
+    for (size_t i = 0; i <= height; i++) ys[i] = crop.y + (i * scale < crop.height ? i * scale : crop.height);
+    write_shaded_blocks(maze, filename, format, xs, width, ys, height);
+    free(ys);
+    free(xs);
+}
+
+void thumbnail_size(const Maze* maze, size_t size, size_t* width, size_t* height) {
+    assert(size > 0);
+    size_t image_w = image_width(maze->cols);
+    size_t image_h = image_height(maze->rows);
+    size_t longest = image_w > image_h ? image_w : image_h;
+    if (size >= longest) {
+        *width = image_w;
+        *height = image_h;
+        return;
+    }
+    // Only the rounding of the shorter side is left to floating point
+    *width = image_w == longest ? size : (size_t)((double)image_w * size / longest + 0.5);
+    *height = image_h == longest ? size : (size_t)((double)image_h * size / longest + 0.5);
+    if (*width < 1) *width = 1;
+    if (*height < 1) *height = 1;
+}
+
+// `count + 1` edges splitting `length` pixels into `count` parts, without
+// the product i * length that could overflow
+static void thumbnail_edges(size_t* edges, size_t length, size_t count) {
+    size_t quotient = length / count;
+    size_t remainder = length % count;
+    for (size_t i = 0; i <= count; i++) edges[i] = i * quotient + i * remainder / count;
+}
+
+void render_thumbnail(const Maze* maze, uint8_t* shades, size_t width, size_t height) {
+    assert(width > 0 && width <= image_width(maze->cols));
+    assert(height > 0 && height <= image_height(maze->rows));
+    size_t* xs = (size_t*)alloc_or_die(width + 1, sizeof(size_t), "the block edges");
+    size_t* ys = (size_t*)alloc_or_die(height + 1, sizeof(size_t), "the block edges");
+    thumbnail_edges(xs, image_width(maze->cols), width);
+    thumbnail_edges(ys, image_height(maze->rows), height);
+    shade_blocks(maze, shades, xs, width, ys, height);
+    free(ys);
+    free(xs);
+}
+
+void render_thumbnail_to_file(const Maze* maze, const char* filename, ImageFormat format, size_t size) {
+    size_t width = 0, height = 0;
+    thumbnail_size(maze, size, &width, &height);
+    size_t* xs = (size_t*)alloc_or_die(width + 1, sizeof(size_t), "the block edges");
+    size_t* ys = (size_t*)alloc_or_die(height + 1, sizeof(size_t), "the block edges");
+    thumbnail_edges(xs, image_width(maze->cols), width);
+    thumbnail_edges(ys, image_height(maze->rows), height);
+    write_shaded_blocks(maze, filename, format, xs, width, ys, height);
+    free(ys);
+    free(xs);
+}
+#endif // RENDER_H_IMPLEMENTATION
@@ -0,0 +1,84 @@
+// Small seedable pseudo-random number generator (xoshiro256**)
+//
+// Every generator owns its whole state, so threads never share one and the
+// same seed always reproduces the same sequence.
+//
+// Define RNG_H_IMPLEMENTATION in exactly one file before including this
+// header to get the function definitions.
+#ifndef RNG_H_
+#define RNG_H_
+
+#include <stdint.h>
+
+typedef struct {
+    uint64_t s[4];
+} Rng;
+
+Rng rng_init(uint64_t seed);
+// An independent generator for sub-task `stream` of a run seeded with `seed`,
+// e.g. one per tile, so results don't depend on which thread did the work
+Rng rng_stream(uint64_t seed, uint64_t stream);
+uint64_t rng_next(Rng* rng);
+// Uniform random number in [0, n), without modulo bias
+uint64_t rng_below(Rng* rng, uint64_t n);
+
+#endif // RNG_H_
+
+#ifdef RNG_H_IMPLEMENTATION
+__extension__ typedef unsigned __int128 rng_u128;
+
+// SplitMix64, only used to spread a seed over the xoshiro state
+static uint64_t rng_splitmix(uint64_t* x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rng_rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+Rng rng_init(uint64_t seed) {
+    Rng rng;
+    for (int i = 0; i < 4; i++) {
+        rng.s[i] = rng_splitmix(&seed);
+    }
+    return rng;
+}
+
+Rng rng_stream(uint64_t seed, uint64_t stream) {
+    uint64_t mixed = seed;
+    rng_splitmix(&mixed);
+    mixed ^= stream * 0xD1B54A32D192ED03ull;
+    return rng_init(rng_splitmix(&mixed));
+}
+
+uint64_t rng_next(Rng* rng) {
+    uint64_t* s = rng->s;
+    uint64_t result = rng_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rng_rotl(s[3], 45);
+    return result;
+}
+
+// Lemire's multiply-and-shift method; the division only happens in the rare
+// case where the low half could land in the biased region
+uint64_t rng_below(Rng* rng, uint64_t n) {
+    rng_u128 m = (rng_u128)rng_next(rng) * n;
+    uint64_t low = (uint64_t)m;
+    if (low < n) {
+        uint64_t threshold = -n % n;
+        while (low < threshold) {
+            m = (rng_u128)rng_next(rng) * n;
+            low = (uint64_t)m;
+        }
+    }
+    return (uint64_t)(m >> 64);
+}
+#endif // RNG_H_IMPLEMENTATION
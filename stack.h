@@ -1,63 +1,113 @@
+// Generic LIFO stack
+//
+// The header works like a template: define the element type (and optionally
+// the struct name and function prefix) before including it. It can be
+// included several times in one translation unit to get several stack types.
+//
+//     #define STACK_TYPE uint32_t
+//     #define STACK_NAME IndexStack
+//     #define STACK_PREFIX index_stack
+//     #define STACK_H_IMPLEMENTATION
+//     #include "stack.h"
+//
+// Without STACK_NAME/STACK_PREFIX the names default to `Stack`/`stack_*`.
 #ifndef STACK_H_
 #define STACK_H_
 
 #include <assert.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-#ifndef STACK_TYPE
-    #define STACK_TYPE int
-#endif
-
-typedef struct {
-    STACK_TYPE* items;
-    size_t count;
-} Stack;
+#include "instrument.h"
 
-Stack stack_init();
-void stack_push(Stack* stack, STACK_TYPE val);
-STACK_TYPE stack_pop(Stack* stack);
-void stack_deinit(Stack* stack);
+#define STACK_INITIAL_CAPACITY 16
 
-#endif // STACK_H_
+#define STACK_CONCAT_(a, b) a##_##b
+#define STACK_CONCAT(a, b) STACK_CONCAT_(a, b)
 
 // Memory util function
-static void is_stack_mem_valid(void* ptr) {
+static inline void is_stack_mem_valid(void* ptr) {
     if (ptr == NULL) {
         fprintf(stderr, "Failed to get appropriate stack memory size\n");
         assert(false);
+        exit(71); // UNIX sysexit.h error code 71
     }
 }
 
+#endif // STACK_H_
+
+#ifndef STACK_TYPE
+    #define STACK_TYPE int
+#endif
+#ifndef STACK_NAME
+    #define STACK_NAME Stack
+#endif
+#ifndef STACK_PREFIX
+    #define STACK_PREFIX stack
+#endif
+#define STACK_FN(name) STACK_CONCAT(STACK_PREFIX, name)
+
+typedef struct {
+    STACK_TYPE* items;
+    size_t count;
+    size_t capacity;
+} STACK_NAME;
+
+STACK_NAME STACK_FN(init)(void);
+// Make sure at least `capacity` items fit without reallocating
+void STACK_FN(reserve)(STACK_NAME* stack, size_t capacity);
+void STACK_FN(push)(STACK_NAME* stack, STACK_TYPE val);
+STACK_TYPE STACK_FN(pop)(STACK_NAME* stack);
+// Drop every item but keep the memory around for the next use
+void STACK_FN(clear)(STACK_NAME* stack);
+void STACK_FN(deinit)(STACK_NAME* stack);
+
 #ifdef STACK_H_IMPLEMENTATION
-Stack stack_init() {
-    return (Stack) {
+STACK_NAME STACK_FN(init)(void) {
+    return (STACK_NAME) {
         .items = NULL,
         .count = 0,
+        .capacity = 0,
     };
 }
 
-void stack_push(Stack* stack, STACK_TYPE val) {
-    stack->count++;
+void STACK_FN(reserve)(STACK_NAME* stack, size_t capacity) {
+    if (capacity <= stack->capacity) return;
 
-    stack->items = (STACK_TYPE*)realloc(stack->items, sizeof(STACK_TYPE) * stack->count);
+    stack->items = (STACK_TYPE*)realloc(stack->items, sizeof(STACK_TYPE) * capacity);
     is_stack_mem_valid(stack->items);
-    stack->items[stack->count - 1] = val;
+    stack->capacity = capacity;
+    INSTR_ADD(stack_reallocs, 1);
 }
 
-STACK_TYPE stack_pop(Stack* stack) {
-    stack->count--;
-
-    STACK_TYPE removed_item = stack->items[stack->count];
-    stack->items = (STACK_TYPE*)realloc(stack->items, sizeof(STACK_TYPE) * stack->count);
-    if (stack->count != 0) {
-        is_stack_mem_valid(stack->items);
+void STACK_FN(push)(STACK_NAME* stack, STACK_TYPE val) {
+    if (stack->count == stack->capacity) {
+        // Grow geometrically so pushing N items costs O(log N) reallocations
+        STACK_FN(reserve)(stack, stack->capacity == 0 ? STACK_INITIAL_CAPACITY : stack->capacity * 2);
     }
-    return removed_item;
+    stack->items[stack->count++] = val;
+}
+
+STACK_TYPE STACK_FN(pop)(STACK_NAME* stack) {
+    assert(stack->count > 0);
+    return stack->items[--stack->count];
 }
 
-void stack_deinit(Stack* stack) {
+void STACK_FN(clear)(STACK_NAME* stack) {
+    stack->count = 0;
+}
+
+void STACK_FN(deinit)(STACK_NAME* stack) {
     free(stack->items);
+    stack->items = NULL;
     stack->count = 0;
+    stack->capacity = 0;
 }
 #endif // STACK_H_IMPLEMENTATION
+
+#undef STACK_FN
+#undef STACK_TYPE
+#undef STACK_NAME
+#undef STACK_PREFIX
+#undef STACK_H_IMPLEMENTATION
@@ -0,0 +1,72 @@
+// Round trips of maze_codec.h: every algorithm, a few odd maze shapes and
+// tile sizes from one cell to larger than the maze, decoded whole and in
+// regions that start and end inside tiles, on tile edges and at the border
+//
+// Usage: test_codec.out
+// Prints the first mismatch and exits with 70, or exits with 0.
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAZE_H_IMPLEMENTATION
+#include "../maze.h"
+#define MAZE_CODEC_H_IMPLEMENTATION
+#include "../maze_codec.h"
+
+static bool same_cells(const Maze* part, const Maze* maze, size_t row, size_t col) {
+    for (size_t r = 0; r < part->rows; r++) {
+        for (size_t c = 0; c < part->cols; c++) {
+            if (maze_cell(part, to_ind(part, r, c)) != maze_cell(maze, to_ind(maze, row + r, col + c))) return false;
+        }
+    }
+    return true;
+}
+
+int main(void) {
+    static const size_t shapes[][2] = { {61, 97}, {1, 40}, {40, 1}, {1, 1}, {26, 26} };
+    static const size_t tile_sizes[] = { 1, 8, 13, 300 };
+    size_t checks = 0;
+    for (size_t a = 0; a < ALGO_COUNT; a++) {
+        for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+            size_t rows = shapes[s][0];
+            size_t cols = shapes[s][1];
+            Env env = env_init(rows, cols, 1000 + s);
+            gen_maze(&env, (MazeAlgorithm)a);
+            env_deinit(&env);
+            for (size_t t = 0; t < sizeof(tile_sizes) / sizeof(tile_sizes[0]); t++) {
+                const char* algo = maze_algorithm_name((MazeAlgorithm)a);
+                EncodedMaze encoded = maze_encode(&env.maze, tile_sizes[t]);
+                Maze decoded = maze_decode(encoded.bytes, encoded.length);
+                if (decoded.rows != rows || decoded.cols != cols || !same_cells(&decoded, &env.maze, 0, 0)) {
+                    fprintf(stderr, "ERROR: %s %zux%zu in tiles of %zu did not decode to the same maze\n", algo, cols,
+                            rows, tile_sizes[t]);
+                    return 70;
+                }
+                maze_deinit(&decoded);
+                checks++;
+
+                // Corners and sizes spread over the maze, including the
+                // whole of it and single cells at the far corner
+                for (size_t i = 0; i < 12; i++) {
+                    size_t row = i * 7 % rows;
+                    size_t col = i * 11 % cols;
+                    size_t height = 1 + i * 5 % (rows - row);
+                    size_t width = 1 + i * 9 % (cols - col);
+                    if (i == 0) height = rows, width = cols;
+                    if (i == 1) row = rows - 1, col = cols - 1, height = 1, width = 1;
+                    Maze part = maze_decode_region(encoded.bytes, encoded.length, row, col, height, width);
+                    if (part.rows != height || part.cols != width || !same_cells(&part, &env.maze, row, col)) {
+                        fprintf(stderr, "ERROR: %s %zux%zu in tiles of %zu: region %zux%zu at (%zu, %zu) differs\n",
+                                algo, cols, rows, tile_sizes[t], width, height, row, col);
+                        return 70;
+                    }
+                    maze_deinit(&part);
+                    checks++;
+                }
+                encoded_maze_deinit(&encoded);
+            }
+            maze_deinit(&env.maze);
+        }
+    }
+    printf("%zu codec checks passed\n", checks);
+    return 0;
+}
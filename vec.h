@@ -1,95 +1,136 @@
+// Generic growable array
+//
+// The header works like a template: define the element type (and optionally
+// the struct name and function prefix) before including it. It can be
+// included several times in one translation unit to get several vec types.
+//
+//     #define VEC_TYPE Wall
+//     #define VEC_NAME WallVec
+//     #define VEC_PREFIX wall_vec
+//     #define VEC_H_IMPLEMENTATION
+//     #include "vec.h"
+//
+// Without VEC_NAME/VEC_PREFIX the names default to `Vec`/`vec_*`.
 #ifndef VEC_H_
 #define VEC_H_
 
 #include <assert.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-#ifndef VEC_TYPE
-    #define VEC_TYPE int
-#endif
-
-typedef struct {
-	VEC_TYPE* items;
-	size_t length;
-} Vec;
+#include "instrument.h"
 
-Vec vec_init();
-void vec_append(Vec* vec, VEC_TYPE val);
-void vec_insert(Vec* vec, VEC_TYPE val, size_t index);
-VEC_TYPE vec_remove(Vec* vec, size_t index);
-void vec_print(const Vec* const vec);
-void vec_deinit(Vec* vec);
+#define VEC_INITIAL_CAPACITY 16
 
-#endif // VEC_H_
+#define VEC_CONCAT_(a, b) a##_##b
+#define VEC_CONCAT(a, b) VEC_CONCAT_(a, b)
 
 // Memory util function
-static void is_vec_mem_valid(void* ptr) {
+static inline void is_vec_mem_valid(void* ptr) {
     if (ptr == NULL) {
         fprintf(stderr, "Failed to get appropriate vec memory size\n");
         assert(false);
+        exit(71); // UNIX sysexit.h error code 71
     }
 }
 
+#endif // VEC_H_
+
+#ifndef VEC_TYPE
+    #define VEC_TYPE int
+#endif
+#ifndef VEC_NAME
+    #define VEC_NAME Vec
+#endif
+#ifndef VEC_PREFIX
+    #define VEC_PREFIX vec
+#endif
+#define VEC_FN(name) VEC_CONCAT(VEC_PREFIX, name)
+
+typedef struct {
+	VEC_TYPE* items;
+	size_t length;
+	size_t capacity;
+} VEC_NAME;
+
+VEC_NAME VEC_FN(init)(void);
+// Make sure at least `capacity` items fit without reallocating
+void VEC_FN(reserve)(VEC_NAME* vec, size_t capacity);
+void VEC_FN(append)(VEC_NAME* vec, VEC_TYPE val);
+void VEC_FN(insert)(VEC_NAME* vec, VEC_TYPE val, size_t index);
+VEC_TYPE VEC_FN(remove)(VEC_NAME* vec, size_t index);
+// Drop every item but keep the memory around for the next use
+void VEC_FN(clear)(VEC_NAME* vec);
+void VEC_FN(deinit)(VEC_NAME* vec);
+
 #ifdef VEC_H_IMPLEMENTATION
-Vec vec_init() {
-	return (Vec) {
+VEC_NAME VEC_FN(init)(void) {
+	return (VEC_NAME) {
 		.items = NULL,
 		.length = 0,
+		.capacity = 0,
 	};
 }
 
-void vec_append(Vec* vec, VEC_TYPE val) {
-	// Increase the length attribute to account for the new value
-	vec->length++;
-	// Reallocate the array to fit the new value
-	vec->items = (VEC_TYPE*)realloc(vec->items, sizeof(VEC_TYPE)*vec->length);
+void VEC_FN(reserve)(VEC_NAME* vec, size_t capacity) {
+	if (capacity <= vec->capacity) return;
+
+	vec->items = (VEC_TYPE*)realloc(vec->items, sizeof(VEC_TYPE)*capacity);
     is_vec_mem_valid(vec->items);
+	vec->capacity = capacity;
+	INSTR_ADD(vec_reallocs, 1);
+}
+
+// Grow geometrically so appending N items costs O(log N) reallocations
+static inline void VEC_FN(grow)(VEC_NAME* vec) {
+	if (vec->length < vec->capacity) return;
+	VEC_FN(reserve)(vec, vec->capacity == 0 ? VEC_INITIAL_CAPACITY : vec->capacity * 2);
+}
+
+void VEC_FN(append)(VEC_NAME* vec, VEC_TYPE val) {
+	VEC_FN(grow)(vec);
 	// Place the final value at the end of the array, i.e. append it
-	vec->items[vec->length - 1] = val;
+	vec->items[vec->length++] = val;
 }
 
-void vec_insert(Vec* vec, VEC_TYPE val, size_t index) {
+void VEC_FN(insert)(VEC_NAME* vec, VEC_TYPE val, size_t index) {
 	assert(index <= vec->length);
-	// Increase the length attribute to account for the new value
-	if (index == vec->length) {
-		vec_append(vec, val);
-		return;
-	}
-	vec->length++;
-	// Reallocate the array to fit the new value
-	vec->items = (VEC_TYPE*)realloc(vec->items, sizeof(VEC_TYPE)*vec->length);
-    is_vec_mem_valid(vec->items);
-	// Traverse the array backwards and move every value with an index
-	// greater than the specified index one position to the right
-	for (size_t i = vec->length - 1; i > index; i--) {
-		vec->items[i] = vec->items[i - 1];
-	}
+	VEC_FN(grow)(vec);
+	// Move every value with an index greater than or equal to the
+	// specified index one position to the right
+	memmove(&vec->items[index + 1], &vec->items[index], sizeof(VEC_TYPE)*(vec->length - index));
 	// At the specified index, place the specified value
 	vec->items[index] = val;
+	vec->length++;
 }
 
-VEC_TYPE vec_remove(Vec* vec, size_t index) {
+VEC_TYPE VEC_FN(remove)(VEC_NAME* vec, size_t index) {
     assert(index < vec->length);
+    VEC_TYPE removed_value = vec->items[index];
     // Decrement the length of the vector
     vec->length--;
-    VEC_TYPE removed_value = vec->items[index];
-
-    // Grab the value to the right starting from current
-    // and shift it right
-    for (size_t i = index; i < vec->length; i++) {
-        vec->items[i] = vec->items[i+1];
-    }
-	// Reallocate the array to removed the value at `index`
-	vec->items = (VEC_TYPE*)realloc(vec->items, sizeof(VEC_TYPE)*vec->length);
-    is_vec_mem_valid(vec->items);
 
+    // Shift every value to the right of `index` one position left
+	memmove(&vec->items[index], &vec->items[index + 1], sizeof(VEC_TYPE)*(vec->length - index));
     return removed_value;
 }
 
-void vec_deinit(Vec* vec) {
+void VEC_FN(clear)(VEC_NAME* vec) {
+	vec->length = 0;
+}
+
+void VEC_FN(deinit)(VEC_NAME* vec) {
 	free(vec->items);
+	vec->items = NULL;
     vec->length = 0;
+	vec->capacity = 0;
 }
-
 #endif // VEC_H_IMPLEMENTATION
+
+#undef VEC_FN
+#undef VEC_TYPE
+#undef VEC_NAME
+#undef VEC_PREFIX
+#undef VEC_H_IMPLEMENTATION